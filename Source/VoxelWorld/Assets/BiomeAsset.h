@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
+#include "VoxelGeneratorAsset.h"
 #include "BiomeAsset.generated.h"
 
 /**
@@ -47,6 +48,14 @@ public:
 	UPROPERTY(VisibleDefaultsOnly, Category = "HeightDistribution", Meta = (DisplayName = "Range"))
 	FString HeightRange;
 
+	// The layers of the biome from the surface downwards. Replace the layers of the generator.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layers")
+	TArray<FVoxelLayerRule> Layers;
+
+	// The voxel below the last layer. Empty uses the fill voxel of the generator.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layers")
+	UVoxelAsset* FillVoxel = nullptr;
+
 
 #if WITH_EDITOR
 	
@@ -0,0 +1,61 @@
+#include "VoxelGeneratorAsset.h"
+#include "BiomeAsset.h"
+
+// Copy the settings of a noise layer into the native noise.
+static FVoxelFractalNoise ToFractalNoise(const FVoxelNoiseLayer& noiseLayer) {
+
+	FVoxelFractalNoise noise;
+	noise.scale = noiseLayer.scale;
+	noise.amplitude = noiseLayer.amplitude;
+	noise.octaves = FMath::Max(noiseLayer.octaves, 1);
+	noise.lacunarity = noiseLayer.lacunarity;
+	noise.gain = noiseLayer.gain;
+	noise.bRidged = noiseLayer.bRidged;
+	return noise;
+}
+
+// Resolve the voxel assets of the layers to their IDs, the generator must not touch UObjects.
+static void ResolveLayers(const TArray<FVoxelLayerRule>& rules, TArray<FVoxelColumnLayer>& layers) {
+
+	for (const FVoxelLayerRule& rule : rules) {
+		FVoxelColumnLayer& layer = layers.AddDefaulted_GetRef();
+		layer.assetID = rule.voxel ? rule.voxel->assetID : 0;
+		layer.thickness = FMath::Max(rule.thickness, 1);
+	}
+}
+
+FVoxelColumnGeneratorPtr UVoxelGeneratorAsset::CreateColumnGenerator(int seed) const {
+
+	TSharedPtr<FVoxelColumnGenerator, ESPMode::ThreadSafe> generator = MakeShared<FVoxelColumnGenerator, ESPMode::ThreadSafe>();
+	generator->baseHeight = baseHeight;
+
+	for (const FVoxelNoiseLayer& noiseLayer : noiseLayers) {
+		generator->heightNoise.Add(ToFractalNoise(noiseLayer));
+	}
+	generator->heatNoise = ToFractalNoise(heatNoise);
+	generator->rainfallNoise = ToFractalNoise(rainfallNoise);
+	generator->bDensity = bDensity;
+	generator->densityNoise = ToFractalNoise(densityNoise);
+
+	ResolveLayers(layers, generator->layers);
+	generator->fillAssetID = fillVoxel ? fillVoxel->assetID : 0;
+
+	// The biome table stores the biomes as bytes.
+	TArray<FVector2D> heatRanges, rainfallRanges;
+	for (const UBiomeAsset* biomeAsset : biomes) {
+		if (!biomeAsset || generator->biomes.Num() == MAX_uint8) continue;
+
+		FVoxelBiome& biome = generator->biomes.AddDefaulted_GetRef();
+		biome.heightMin = biomeAsset->HeightMapMin;
+		biome.heightMax = biomeAsset->HeightMapMax;
+		ResolveLayers(biomeAsset->Layers, biome.layers);
+		biome.fillAssetID = biomeAsset->FillVoxel ? biomeAsset->FillVoxel->assetID : generator->fillAssetID;
+		heatRanges.Add(FVector2D(biomeAsset->HeatMin, biomeAsset->HeatMax));
+		rainfallRanges.Add(FVector2D(biomeAsset->RainFallMin, biomeAsset->RainFallMax));
+	}
+	generator->BuildBiomeTable(heatRanges, rainfallRanges);
+
+	generator->noiseContext = &FSimplexNoiseContext::GetShared(seed);
+	generator->regionMaps = MakeShared<FVoxelRegionMapCache, ESPMode::ThreadSafe>(regionCacheSize);
+	return generator;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "VoxelAsset.h"
+#include "../ChunkManagement/VoxelColumnGenerator.h"
+#include "VoxelGeneratorAsset.generated.h"
+
+class UBiomeAsset;
+
+// A layer of the same voxel below the surface.
+USTRUCT(BlueprintType)
+struct FVoxelLayerRule
+{
+	GENERATED_BODY()
+
+	// The voxel of the layer. Empty means air.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer")
+		UVoxelAsset* voxel = nullptr;
+
+	// The thickness of the layer in voxels.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layer", Meta = (UIMin = 1, UIMax = 64, ClampMin = 1))
+		int thickness = 1;
+};
+
+// A noise pattern summed up from several octaves.
+USTRUCT(BlueprintType)
+struct FVoxelNoiseLayer
+{
+	GENERATED_BODY()
+
+	// The frequency of the first octave per voxel. Smaller values create wider hills.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", Meta = (UIMin = 0.001, UIMax = 1, ClampMin = 0))
+		float scale = 0.01f;
+
+	// The maximum height variation in voxels. Only used for the surface height.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", Meta = (UIMin = 0, UIMax = 64))
+		float amplitude = 8.0f;
+
+	// The number of octaves. Every octave adds finer details.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", Meta = (UIMin = 1, UIMax = 8, ClampMin = 1, ClampMax = 16))
+		int octaves = 1;
+
+	// The frequency of every octave compared to the previous one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", Meta = (UIMin = 1, UIMax = 4, ClampMin = 0))
+		float lacunarity = 2.0f;
+
+	// The weight of every octave compared to the previous one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise", Meta = (UIMin = 0, UIMax = 1, ClampMin = 0))
+		float gain = 0.5f;
+
+	// Form sharp ridges like mountain ranges instead of round hills.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Noise")
+		bool bRidged = false;
+};
+
+/* Describes the terrain of a world as a surface height and a table of layers below it.
+   The chunks are filled natively column by column, Blueprints only configure the asset. */
+UCLASS(BlueprintType)
+class VOXELWORLD_API UVoxelGeneratorAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+/// ------ Height ------ \\\
+
+public:
+	// The surface height in voxels without any noise.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Height", Meta = (UIMin = 0, UIMax = 512, ClampMin = 0))
+		int baseHeight = 30;
+
+	// The noise patterns added to the surface height.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Height")
+		TArray<FVoxelNoiseLayer> noiseLayers = { FVoxelNoiseLayer() };
+
+/// ------ Density ------ \\\
+
+public:
+	// Shape the surface with a 3D density, which adds overhangs and caves.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Density")
+		bool bDensity = false;
+
+	// The 3D noise of the density. The amplitude is the number of voxels the surface can move up or down.
+	// Sampled every 4 voxels horizontally and every 8 voxels vertically, so details smaller than that are smoothed out.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Density", Meta = (EditCondition = "bDensity"))
+		FVoxelNoiseLayer densityNoise;
+
+/// ------ Climate ------ \\\
+
+public:
+	// The noise of the heat, mapped between 0 and 1 like the ranges of the biomes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Climate")
+		FVoxelNoiseLayer heatNoise;
+
+	// The noise of the rainfall, mapped between 0 and 1 like the ranges of the biomes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Climate")
+		FVoxelNoiseLayer rainfallNoise;
+
+	// The biomes chosen by the heat and rainfall. Without biomes the base height and the layers of the generator are used.
+	// Every biome spreads the height noise between its lowest and highest surface.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Climate")
+		TArray<UBiomeAsset*> biomes;
+
+/// ------ Layers ------ \\\
+
+public:
+	// The layers from the surface downwards. The first layer starts at the surface voxel.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layers")
+		TArray<FVoxelLayerRule> layers;
+
+	// The voxel below the last layer.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Layers")
+		UVoxelAsset* fillVoxel = nullptr;
+
+/// ------ Generation ------ \\\
+
+public:
+	// The number of regions (16 by 16 chunks) whose height and climate maps are kept for the chunks generated next.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Generation", Meta = (UIMin = 1, UIMax = 64, ClampMin = 1))
+		int regionCacheSize = 9;
+
+	// Resolve the asset into a generator, which can be used on any thread.
+	// @param seed - The seed of the world.
+	// @return - The column generator.
+	FVoxelColumnGeneratorPtr CreateColumnGenerator(int seed) const;
+};
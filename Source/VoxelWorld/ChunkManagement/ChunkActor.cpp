@@ -1,20 +1,11 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "ChunkActor.h"
+#include "ChunkManager.h"
 
-#pragma region Voxel Values
-const int bTriangles[] = { 2,1,0,0,3,2 };
-const FVector2D bUVs[] = { FVector2D(0,0), FVector2D(0,1), FVector2D(1,1), FVector2D(1,0) };
-const FVector bNormals0[] = { FVector(0,0,1), FVector(0,0,1), FVector(0,0,1), FVector(0,0,1) };
-const FVector bNormals1[] = { FVector(0,0,-1), FVector(0,0,-1), FVector(0,0,-1), FVector(0,0,-1) };
-const FVector bNormals2[] = { FVector(0,1,0), FVector(0,1,0), FVector(0,1,0), FVector(0,1,0) };
-const FVector bNormals3[] = { FVector(0,-1,0), FVector(0,-1,0), FVector(0,-1,0), FVector(0,-1,0) };
-const FVector bNormals4[] = { FVector(1,0,0), FVector(1,0,0), FVector(1,0,0), FVector(1,0,0) };
-const FVector bNormals5[] = { FVector(-1,0,0), FVector(-1,0,0), FVector(-1,0,0), FVector(-1,0,0) };
-const FVector bMask[] = { FVector(0,0,1), FVector(0,0,-1), FVector(0,1,0), FVector(0,-1,0), FVector(1,0,0), FVector(-1,0,0) };
-#pragma endregion
-
-
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Sections Created"), STAT_VoxelMeshSectionsCreated, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Sections Updated"), STAT_VoxelMeshSectionsUpdated, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Sections Unchanged"), STAT_VoxelMeshSectionsUnchanged, STATGROUP_VoxelWorld);
 
 /// ------ FUNCTIONS ------ \\\
 /// ------ Initialization ------ \\\
@@ -35,6 +26,8 @@ void AChunkActor::Initialize(TArray<UVoxelAsset*> _assetList, int _voxelSize, in
 	regionSize = _regionSize;
 	chunkIndexX = FMath::RoundToInt(_position.X);
 	chunkIndexY = FMath::RoundToInt(_position.Y);
+	chunkCoordinates = FIntPoint(chunkIndexX, chunkIndexY);
+	bGenerated = false;
 	chunkIndexXOld = chunkIndexX;
 	chunkIndexYOld = chunkIndexY;
 
@@ -44,7 +37,19 @@ void AChunkActor::Initialize(TArray<UVoxelAsset*> _assetList, int _voxelSize, in
 	voxelSizeHalved = voxelSize / 2;
 	chunkWidthSquared = chunkWidth * chunkWidth;
 	chunkOffset = -chunkWidth / 2 * voxelSize;
-	voxelAssetIDs.SetNumUninitialized(chunkTotalElements);
+
+	// Chunks without a chunk manager keep their voxels to themselves.
+	chunkData = MakeShared<FVoxelChunkData>();
+	chunkData->coordinates = chunkCoordinates;
+	chunkData->voxelAssetIDs.Init(chunkWidth, chunkHeight, sectionHeight, FVoxelSectionStorage::GetDefaultLayout(), 0);
+
+	// Every section needs to be meshed initially.
+	numOfSections = FMath::DivideAndRoundUp(chunkHeight, sectionHeight);
+	dirtySections.Init(true, numOfSections);
+	appliedSectionRevisions.Init(meshRevision, numOfSections);
+	meshSectionVertexCounts.Init(0, numOfSections * assetList.Num());
+	meshSectionHashes.Init(0, numOfSections * assetList.Num());
+	collisionSectionHashes.Init(0, numOfSections);
 
 
 	int indexX = chunkIndexX;
@@ -66,6 +71,10 @@ void AChunkActor::Initialize(TArray<UVoxelAsset*> _assetList, int _voxelSize, in
 	chunkIndexX = (sign * chunkIndexY) % regionSize;
 
 
+	chunkData->assignedRegion = assignedRegion;
+	chunkData->regionIndexX = chunkIndexX;
+	chunkData->regionIndexY = chunkIndexY;
+
 	// Set the name of the chunk
 	FString string = "Chunk_(" + FString::FromInt(chunkIndexX) + ")_(" + FString::FromInt(chunkIndexY) + ")_Reg" + FString::FromInt(chunkIndexX) + FString::FromInt(chunkIndexY);
 	chunkName = FName(*string);
@@ -81,107 +90,292 @@ void AChunkActor::Initialize(TArray<UVoxelAsset*> _assetList, int _voxelSize, in
 
 
 
+}
+
+void AChunkActor::SetColumnGenerator(const FVoxelColumnGeneratorPtr& generator) {
+	columnGenerator = generator;
+}
+
+void AChunkActor::SetChunkData(const FVoxelChunkDataPtr& data) {
+
+	check(data.IsValid());
+
+	// Stored voxels keep their size and save location.
+	if (!data->bGenerated) {
+		data->voxelAssetIDs.Init(chunkWidth, chunkHeight, sectionHeight, FVoxelSectionStorage::GetDefaultLayout(), 0);
+		data->assignedRegion = chunkData->assignedRegion;
+		data->regionIndexX = chunkData->regionIndexX;
+		data->regionIndexY = chunkData->regionIndexY;
+	}
+	else if (data->voxelAssetIDs.Num() != chunkTotalElements) {
+		PrintDebugWarning({
+			"Stored chunk data doesn't fit the chunk.",
+			"Reason: The chunk size changed!",
+			"Stored voxels: " + FString::FromInt(data->voxelAssetIDs.Num())
+			});
+		data->bGenerated = false;
+		data->voxelAssetIDs.Init(chunkWidth, chunkHeight, sectionHeight, FVoxelSectionStorage::GetDefaultLayout(), 0);
+	}
+	chunkData = data;
+}
+
+void AChunkActor::ReleaseChunk() {
+
+	// Mesh builds that are still running are ignored from now on.
+	appliedSectionRevisions.Init(meshRevision, numOfSections);
+	bGenerated = false;
+	chunkData.Reset();
+
+	if (proceduralComponent)
+		proceduralComponent->ClearAllMeshSections();
+	meshSectionVertexCounts.Init(0, meshSectionVertexCounts.Num());
+	meshSectionHashes.Init(0, meshSectionHashes.Num());
+	collisionSectionHashes.Init(0, collisionSectionHashes.Num());
+	SetActorHiddenInGame(true);
+
+	// Recycled chunks start with the default detail again.
+	const AChunkActor* defaults = GetClass()->GetDefaultObject<AChunkActor>();
+	lodLevel = defaults->lodLevel;
+	bCollisionEnabled = defaults->bCollisionEnabled;
 }
 
 /// ------ Generation ------ \\\
 
-/* Generate the chunk with it's noise and voxels. */
-bool AChunkActor::GenerateChunk(const TMap<int,int>& chunkMap) {
+void AChunkActor::SetupMeshComponent() {
+
+	// Recycled chunks keep their procedural mesh component.
+	if (proceduralComponent) {
+		SetActorHiddenInGame(false);
+		return;
+	}
 
-	// Setup the chunk internally
 	proceduralComponent = NewObject<UProceduralMeshComponent>(this, chunkName);
+	proceduralComponent->bUseAsyncCooking = true;
 	FTransform transform = RootComponent->GetComponentTransform();
 	proceduralComponent->RegisterComponent();
-	proceduralComponent->SetMobility(EComponentMobility::Static);
 	RootComponent = proceduralComponent;
 	RootComponent->SetWorldTransform(transform);
+}
 
-	for (const TPair<int, int>& voxel : chunkMap) {
-		if (!voxelAssetIDs.IsValidIndex(voxel.Key)) {
-			voxelAssetIDs.SetNumZeroed(voxel.Key + 1, false);
-		}
-		voxelAssetIDs[voxel.Key] = voxel.Value;
-	}
+/* Generate the chunk with it's noise and voxels. */
+bool AChunkActor::GenerateChunk(const TMap<int,int>& chunkMap) {
 
-	// Try to update the procedural mesh.
-	if (!UpdateMesh()) {
+	// Setup the chunk internally
+	SetupMeshComponent();
 
-		// Aboard the generation, if the mesh couldn't been updated.
-		PrintDebugWarning({
-			"Generation of chunk failed.",
-			"Reason: Mesh couldn't been updated!"
-			});
-		return false;
+	for (const TPair<int, int>& voxel : chunkMap) {
+		if (chunkData->voxelAssetIDs.IsValidIndex(voxel.Key))
+			chunkData->voxelAssetIDs.Set(voxel.Key, voxel.Value);
 	}
-	else
-		return true;
+	chunkData->bGenerated = true;
+	chunkData->bModified = true;
+
+	return FinishGeneration();
 }
 
 /* Generate the chunk with it's noise and voxels. */
 bool AChunkActor::GenerateChunk() {
 
+	TArray<int> noise;
+	PrepareGeneration(noise);
+	FillVoxels(noise);
+	return FinishGeneration();
+}
+
+void AChunkActor::PrepareGeneration(TArray<int>& noise) {
+
 	// Setup the chunk internally
-	proceduralComponent = NewObject<UProceduralMeshComponent>(this, chunkName);
-	FTransform transform = RootComponent->GetComponentTransform();
-	proceduralComponent->RegisterComponent();
-	RootComponent = proceduralComponent;
-	RootComponent->SetWorldTransform(transform);
-	markedForSaving = true;
+	SetupMeshComponent();
 
-	// Initialize the noise Array.
-	TArray<int> noise;
-	noise.SetNum(chunkWidthSquared);
+	// Voxels kept inside the world store only need a new mesh.
+	noise.Reset();
+	if (chunkData->bGenerated) return;
+	chunkData->markedForSaving = true;
+
+	// The column generator calculates the heights natively on the thread filling the voxels.
+	if (columnGenerator) return;
 
 	// Set the noise value of each position.
+	noise.SetNum(chunkWidthSquared);
 	for (int x = 0; x < chunkWidth; x++) {
 	for (int y = 0; y < chunkWidth; y++) {
 		noise[x + y * chunkWidth] = CalculateNoiseValue(x, y);
 	}
 	}
+}
+
+bool AChunkActor::CanFillVoxelsInParallel() const {
+	return columnGenerator.IsValid() || !GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(AChunkActor, VoxelAssetDistribution));
+}
+
+void AChunkActor::FillVoxels(const TArray<int>& noise) {
+
+	if (chunkData->bGenerated) return;
+
+	// The column keys of the column generator replace the noise.
+	TArray<int> columns;
+	if (columnGenerator) {
+		columnGenerator->CalculateColumns(chunkCoordinates, chunkWidth, columns);
+	}
 
 	// Calculate the ID of very voxel inside the chunk.
-	for (int x = 0; x < chunkWidth; x++) {
-	for (int y = 0; y < chunkWidth; y++) {
-	for (int z = 0; z < chunkHeight; z++) {
+	// The native distribution is called directly, because calling the event goes through the reflection system.
+	bool bNativeDistribution = CanFillVoxelsInParallel();
+	DispatchChunkDims(chunkWidth, chunkHeight, [&](const auto& dims) {
+		GenerateVoxels(dims, columnGenerator ? columns : noise, bNativeDistribution);
+	});
+	chunkData->bGenerated = true;
+}
+
+bool AChunkActor::FinishGeneration(const TSet<FIntPoint>* generatedTogether) {
+
+	// Try to update the procedural mesh.
+	bGenerated = true;
+	MarkAllSectionsDirty();
+	if (!RequestMeshUpdate()) {
+
+		// Aboard the generation, if the mesh couldn't been updated.
+		PrintDebugWarning({
+			"Generation of chunk failed.",
+			"Reason: Mesh couldn't been updated!"
+			});
+		return false;
+	}
 
-		// Calculate the index and corresponding asset ID.
-		int index = x + y * chunkWidth + z * chunkWidthSquared;
-		int voxelAssetID = VoxelAssetDistribution(z, noise[x + y * chunkWidth]);
-		voxelAssetChanged.Add(index);
+	// Let the neighbours cull the faces towards this chunk. Neighbours generated together already saw its voxels.
+	for (int face = 2; face < 6; face++) {
+		AChunkActor* neighbour = GetNeighbour(face);
+		if (!neighbour) continue;
+		if (generatedTogether && generatedTogether->Contains(neighbour->chunkCoordinates)) continue;
 
-		// Set the calculated asset ID.
-		if (IsValidVoxelID(voxelAssetID)) {
-			voxelAssetIDs[index] = voxelAssetID;
+		neighbour->MarkBorderDirty(face ^ 1);
+		neighbour->RequestMeshUpdate();
+	}
+	return true;
+}
+
+template<typename TDims>
+void AChunkActor::GenerateVoxels(const TDims& dims, const TArray<int>& noise, bool bNativeDistribution) {
+
+	// The native distribution only depends on the height and the noise value, so it is evaluated once per distinct noise value.
+	// Blueprint overrides may be random or stateful, so every column keeps its own entry and they are still called for every voxel.
+	TArray<int> noiseValues;
+	TMap<int, int> noiseIndices;
+	TArray<int> columnNoiseIndices;
+	columnNoiseIndices.SetNumUninitialized(noise.Num());
+	for (int column = 0; column < noise.Num(); column++) {
+		if (!bNativeDistribution) {
+			noiseValues.Add(noise[column]);
+			columnNoiseIndices[column] = column;
+			continue;
+		}
+
+		int* noiseIndex = noiseIndices.Find(noise[column]);
+		if (!noiseIndex) {
+			noiseIndex = &noiseIndices.Add(noise[column], noiseValues.Num());
+			noiseValues.Add(noise[column]);
 		}
-		else {
-			voxelAssetIDs[index] = 0;
+		columnNoiseIndices[column] = *noiseIndex;
+	}
+
+	// Calculate the asset ID for every height and distinct noise value.
+	const int numOfNoiseValues = noiseValues.Num();
+	TArray<int> distribution;
+	distribution.SetNumUninitialized(dims.GetHeight() * numOfNoiseValues);
+	if (columnGenerator) {
+
+		// Fill a whole column per distinct surface height.
+		TArray<int> column;
+		column.SetNumUninitialized(dims.GetHeight());
+		for (int n = 0; n < numOfNoiseValues; n++) {
+			columnGenerator->FillColumn(noiseValues[n], dims.GetHeight(), column.GetData());
+			for (int z = 0; z < dims.GetHeight(); z++) {
+				distribution[n + z * numOfNoiseValues] = column[z];
+			}
+		}
+	}
+	else if (bNativeDistribution) {
+		for (int z = 0; z < dims.GetHeight(); z++) {
+		for (int n = 0; n < numOfNoiseValues; n++) {
+			distribution[n + z * numOfNoiseValues] = VoxelAssetDistribution_Implementation(z, noiseValues[n]);
+		}
+		}
+	}
+	else {
+
+		// Call the Blueprint override in the same order as voxel by voxel generation.
+		for (int x = 0; x < dims.GetWidth(); x++) {
+		for (int y = 0; y < dims.GetWidth(); y++) {
+		for (int z = 0; z < dims.GetHeight(); z++) {
+			int column = dims.GetColumn(x, y);
+			distribution[column + z * numOfNoiseValues] = VoxelAssetDistribution(z, noiseValues[column]);
+		}
+		}
+		}
+	}
+
+	for (int z = 0; z < dims.GetHeight(); z++) {
+	for (int n = 0; n < numOfNoiseValues; n++) {
+		int voxelAssetID = distribution[n + z * numOfNoiseValues];
+
+		// Replace invalid asset IDs.
+		if (!IsValidVoxelID(voxelAssetID)) {
 			PrintDebugWarning({
 				"Couldn't set the voxel ID.",
 				"Reason: Voxel ID is not vaild!",
 				"Replaced the ID with 0.",
 				"Given voxel ID: " + FString::FromInt(voxelAssetID),
-				"Voxel Index: " + FString::FromInt(index),
-				"X Position: " + FString::FromInt(x),
-				"Y Position: " + FString::FromInt(y),
+				"Noise value: " + FString::FromInt(noiseValues[n]),
 				"Z Position: " + FString::FromInt(z)
 				});
+			voxelAssetID = 0;
 		}
-	}
+		distribution[n + z * numOfNoiseValues] = voxelAssetID;
 	}
 	}
 
-	// Try to update the procedural mesh.
-	if (!UpdateMesh()) {
+	// The 3D density of the column generator adds overhangs and caves around the surface.
+	FVoxelDensityBand density;
+	if (columnGenerator)
+		columnGenerator->CalculateDensity(chunkCoordinates, dims.GetWidth(), dims.GetHeight(), noise, density);
 
-		// Aboard the generation, if the mesh couldn't been updated.
-		PrintDebugWarning({
-			"Generation of chunk failed.",
-			"Reason: Mesh couldn't been updated!"
-			});
-		return false;
+	for (int section = 0; section < numOfSections; section++) {
+		int zMin = section * sectionHeight;
+		int zMax = FMath::Min(zMin + sectionHeight, dims.GetHeight());
+
+		// Store sections with a single asset ID without touching their voxels.
+		int firstAssetID = distribution[zMin * numOfNoiseValues];
+		bool bUniform = !density.Overlaps(zMin, zMax);
+		for (int i = zMin * numOfNoiseValues; i < zMax * numOfNoiseValues && bUniform; i++) {
+			bUniform = distribution[i] == firstAssetID;
+		}
+
+		if (bUniform) {
+			chunkData->voxelAssetIDs.SetSection(section, firstAssetID);
+			for (int index = dims.GetIndex(0, 0, zMin); index < dims.GetIndex(0, 0, zMax); index++) {
+				chunkData->voxelAssetChanged.Add(index);
+			}
+			continue;
+		}
+
+		// Write the voxels of mixed sections one by one.
+		for (int z = zMin; z < zMax; z++) {
+		for (int y = 0; y < dims.GetWidth(); y++) {
+		for (int x = 0; x < dims.GetWidth(); x++) {
+			int index = dims.GetIndex(x, y, z);
+			int assetID = distribution[columnNoiseIndices[dims.GetColumn(x, y)] + z * numOfNoiseValues];
+			if (density.Contains(z)) {
+				if (!density.IsSolid(x, y, z))
+					assetID = 0;
+				else if (assetID == 0)
+					assetID = columnGenerator->GetOverhangAssetID(noise[dims.GetColumn(x, y)]);
+			}
+			chunkData->voxelAssetIDs.Set(x, y, z, assetID);
+			chunkData->voxelAssetChanged.Add(index);
+		}
+		}
+		}
 	}
-	else
-		return true;
 }
 
 int AChunkActor::CalculateNoiseValue_Implementation(const int& x, const int& y) {
@@ -219,6 +413,16 @@ bool AChunkActor::IsValidVoxelID(int assetID) {
 
 bool AChunkActor::ReplaceVoxel(FVector position, int voxelID) {
 
+	// Calculate the position of the voxel that will be changed.
+	FVector adjustedPosition = position + FVector(chunkOffset - voxelSizeHalved, chunkOffset + voxelSizeHalved, voxelSize) - this->GetActorLocation() ;
+	int x = FMath::RoundToInt(adjustedPosition.X / voxelSize);
+	int y = FMath::RoundToInt(adjustedPosition.Y / voxelSize);
+	int z = FMath::RoundToInt(adjustedPosition.Z / voxelSize);
+	return ReplaceVoxelAt(x, y, z, voxelID);
+}
+
+bool AChunkActor::ReplaceVoxelAt(int x, int y, int z, int voxelID) {
+
 	// Check if the given ID is valid.
 	if (!IsValidVoxelID(voxelID)) {
 		PrintDebugWarning({ 
@@ -229,22 +433,27 @@ bool AChunkActor::ReplaceVoxel(FVector position, int voxelID) {
 		return false;
 	}
 
-	// Calculate the index of the voxel that will be changed.
-	FVector adjustedPosition = position + FVector(chunkOffset - voxelSizeHalved, chunkOffset + voxelSizeHalved, voxelSize) - this->GetActorLocation() ;
-	int x = FMath::RoundToInt(adjustedPosition.X / voxelSize);
-	int y = FMath::RoundToInt(adjustedPosition.Y / voxelSize);
-	int z = FMath::RoundToInt(adjustedPosition.Z / voxelSize);
+	// Check if the voxel is inside the chunk.
+	if (x < 0 || x >= chunkWidth || y < 0 || y >= chunkWidth || z < 0 || z >= chunkHeight) {
+		PrintDebugWarning({
+			"Aborted replacement of voxel.",
+			"Reason: Voxel is outside of the chunk!",
+			"Voxel position: " + FString::FromInt(x) + ", " + FString::FromInt(y) + ", " + FString::FromInt(z)
+			});
+		return false;
+	}
 	int index = x + y * chunkWidth + z * chunkWidthSquared;
 
 	// Replace the voxel ID with the new one.
-	int voxelIDold = voxelAssetIDs[index];
-	voxelAssetIDs[index] = voxelID;
+	int voxelIDold = chunkData->voxelAssetIDs.Get(x, y, z);
+	chunkData->voxelAssetIDs.Set(x, y, z, voxelID);
+	MarkSectionDirty(z);
 
 	// Try to update the procedural mesh.
-	if (!UpdateMesh()) {
+	if (!RequestMeshUpdate()) {
 
 		// Set the old ID, if the updated failed.
-		voxelAssetIDs[index] = voxelIDold;
+		chunkData->voxelAssetIDs.Set(x, y, z, voxelIDold);
 		PrintDebugWarning({ 
 			"Aborted replacement of voxel.",
 			"Reason: Mesh couldn't been updated!",
@@ -255,8 +464,22 @@ bool AChunkActor::ReplaceVoxel(FVector position, int voxelID) {
 		return false;
 	}
 
-	markedForSaving = true;
-	voxelAssetChanged.Add(index);
+	// Let the neighbours update the faces towards the changed voxel. They see the whole border cell it is part of.
+	int cellSize = FChunkMesher::GetCellSize(chunkWidth, lodLevel);
+	int faces[] = {
+		y >= chunkWidth - cellSize ? 2 : (y < cellSize ? 3 : -1),
+		x >= chunkWidth - cellSize ? 4 : (x < cellSize ? 5 : -1)
+	};
+	for (int face : faces) {
+		if (AChunkActor* neighbour = GetNeighbour(face)) {
+			neighbour->MarkSectionDirty(z);
+			neighbour->RequestMeshUpdate();
+		}
+	}
+
+	chunkData->markedForSaving = true;
+	chunkData->bModified = true;
+	chunkData->voxelAssetChanged.Add(index);
 	return true;
 }
 
@@ -271,175 +494,322 @@ bool AChunkActor::UpdateMesh() {
 		return false;
 	}
 
-	// Initialize the needed amount of voxel assets.
-	TArray<FVoxelMeshInformation> voxelMeshInformation;
-	voxelMeshInformation.SetNum(assetList.Num());
-	int numOfElements = 0;
+	// Build and upload the mesh of every section right away.
+	MarkAllSectionsDirty();
+	FChunkMeshResult result;
+	result.chunk = this;
+	result.revision = ++meshRevision;
+	FChunkMesher::BuildMesh(*CreateMeshSnapshot(), result);
+	ApplyMeshUpdate(result);
+	return true;
+}
 
-	// Check every Voxel position to creat the mesh
-	for (int x = 0; x < chunkWidth; x++) {
-	for (int y = 0; y < chunkWidth; y++) {
-	for (int z = 0; z < chunkHeight; z++) {
-		int index = x + y * chunkWidth + z * chunkWidthSquared;
-		int voxelAssetID = voxelAssetIDs[index];
+bool AChunkActor::RequestMeshUpdate() {
 
-		// Check if the asset ID is valid.
-		if (voxelAssetID == 0) continue;
-		if (!IsValidVoxelID(voxelAssetID)) {
-			PrintDebugWarning({
-				"Couldn't process voxel ID.",
-				"Reason: Voxel ID is not vaild!",
-				"Skipped this voxel.",
-				"Given voxel ID: " + FString::FromInt(voxelAssetID),
-				"Voxel Index: " + FString::FromInt(index),
-				"X Position: " + FString::FromInt(x),
-				"Y Position: " + FString::FromInt(y),
-				"Z Position: " + FString::FromInt(z)
-				});
-			continue;
+	// Check, if there is at least one valid voxel asset.
+	if (assetList.Num() < 1) {
+		PrintDebugWarning({
+			"Aboarded mesh update.",
+			"Reason: No available voxel assets!"
+			});
+		return false;
+	}
+
+	// Without a chunk manager nobody uploads the result, so update synchronously.
+	AChunkManager* manager = Cast<AChunkManager>(GetOwner());
+	if (!manager)
+		return UpdateMesh();
+
+	// Build the mesh in the background.
+	FChunkMeshResultPtr result = MakeShared<FChunkMeshResult, ESPMode::ThreadSafe>();
+	result->chunk = this;
+	result->revision = ++meshRevision;
+	(new FAutoDeleteAsyncTask<FChunkMeshTask>(CreateMeshSnapshot(), result, manager->GetMeshResultQueue()))->StartBackgroundTask();
+	return true;
+}
+
+bool AChunkActor::SetLODLevel(int level) {
+
+	level = FMath::Clamp(level, 0, 3);
+	if (level == lodLevel) return false;
+
+	// The whole chunk is meshed with the new cell size.
+	lodLevel = level;
+	if (!bGenerated) return true;
+	MarkAllSectionsDirty();
+	RequestMeshUpdate();
+
+	// The neighbours switch between culling against this chunk and showing a skirt towards it.
+	for (int face = 2; face < 6; face++) {
+		if (AChunkActor* neighbour = GetNeighbour(face)) {
+			neighbour->MarkBorderDirty(face ^ 1);
+			neighbour->RequestMeshUpdate();
 		}
+	}
+	return true;
+}
 
-		#pragma region Calculate values for the procedual mesh
-
-		// Setup the reference to the voxel mesh information.
-		TArray<FVector>& Vertices = voxelMeshInformation[voxelAssetID].Vertices;
-		TArray<int>& Triangles = voxelMeshInformation[voxelAssetID].Triangles;
-		TArray<FVector>& Normals = voxelMeshInformation[voxelAssetID].Normals;
-		TArray<FVector2D>& UVs = voxelMeshInformation[voxelAssetID].UVs;
-		TArray<FColor>& VertexColors = voxelMeshInformation[voxelAssetID].VertexColors;
-		TArray<FProcMeshTangent>& Tangents = voxelMeshInformation[voxelAssetID].Tangents;
-
-		int numOfTriangle = 0;
-		for (int i = 0; i < 6; i++) {
-			int newIndex = index + bMask[i].X + bMask[i].Y * chunkWidth + bMask[i].Z * chunkWidthSquared;
-
-			// Check, if verticies needs to be calculated
-			bool flag = false;
-			if ((x + bMask[i].X < chunkWidth) && (x + bMask[i].X >= 0) && (y + bMask[i].Y < chunkWidth) && (y + bMask[i].Y >= 0)) {
-				if (voxelAssetIDs.IsValidIndex(newIndex))
-					if (voxelAssetIDs[newIndex] < 1) 
-						flag = true;
-			}
-			else 
-				flag = true;
-
-			if (!flag) continue;
-
-			Triangles.Add(bTriangles[0] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			Triangles.Add(bTriangles[1] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			Triangles.Add(bTriangles[2] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			Triangles.Add(bTriangles[3] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			Triangles.Add(bTriangles[4] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			Triangles.Add(bTriangles[5] + numOfTriangle + voxelMeshInformation[voxelAssetID].elementID);
-			numOfTriangle += 4;
-
-			// Set the verticies for the faces.
-			switch (i) {
-			case 0: {
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
-
-				Normals.Append(bNormals0, UE_ARRAY_COUNT(bNormals0));
-				break;
-			}
-			case 1: {
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
+void AChunkActor::SetChunkCollision(bool bEnabled) {
 
-				Normals.Append(bNormals1, UE_ARRAY_COUNT(bNormals1));
-				break;
-			}
-			case 2: {
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
+	if (bEnabled == bCollisionEnabled) return;
+	bCollisionEnabled = bEnabled;
 
-				Normals.Append(bNormals2, UE_ARRAY_COUNT(bNormals2));
-				break;
-			}
-			case 3: {
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
+	// The collision is built together with the next mesh. Unchanged render sections aren't uploaded again.
+	if (bEnabled) {
+		if (!bGenerated) return;
+		MarkAllSectionsDirty();
+		RequestMeshUpdate();
+		return;
+	}
 
-				Normals.Append(bNormals3, UE_ARRAY_COUNT(bNormals3));
-				break;
-			}
-			case 4: {
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + (x + 1) * voxelSize,		chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
+	// Remove the collision of every section right away.
+	if (!proceduralComponent) return;
+	for (int s = 0; s < numOfSections; s++) {
+		int collisionSectionIndex = GetCollisionSectionIndex(s);
+		if (collisionSectionHashes[s] != 0 && collisionSectionIndex < proceduralComponent->GetNumSections())
+			proceduralComponent->ClearMeshSection(collisionSectionIndex);
+		collisionSectionHashes[s] = 0;
+	}
+}
 
-				Normals.Append(bNormals4, UE_ARRAY_COUNT(bNormals4));
-				break;
+void AChunkActor::ApplyMeshUpdate(const FChunkMeshResult& result) {
+
+	if (!proceduralComponent) return;
+
+	if (result.numOfInvalidVoxels > 0)
+		PrintDebugWarning({
+			"Couldn't process voxel ID.",
+			"Reason: Voxel ID is not vaild!",
+			"Skipped voxels: " + FString::FromInt(result.numOfInvalidVoxels)
+			});
+	lastMeshBuildAllocations = result.numOfAllocations;
+
+	for (const FChunkSectionMesh& section : result.sections) {
+
+		// Skip sections that have been overtaken by a newer result.
+		if (!appliedSectionRevisions.IsValidIndex(section.sectionIndex) || result.revision <= appliedSectionRevisions[section.sectionIndex])
+			continue;
+		appliedSectionRevisions[section.sectionIndex] = result.revision;
+
+		// Replace the mesh sections of every voxel asset inside this vertical section.
+		for (int m = 1; m < assetList.Num(); m++) {
+			int meshSectionIndex = GetMeshSectionIndex(section.sectionIndex, m);
+
+			// Remove the mesh section, if it's empty now.
+			if (!section.voxelMeshInformation.IsValidIndex(m) || section.voxelMeshInformation[m].Vertices.Num() == 0) {
+				if (meshSectionVertexCounts[meshSectionIndex] > 0 && meshSectionIndex < proceduralComponent->GetNumSections())
+					proceduralComponent->ClearMeshSection(meshSectionIndex);
+				meshSectionVertexCounts[meshSectionIndex] = 0;
+				meshSectionHashes[meshSectionIndex] = 0;
+				continue;
 			}
-			case 5: {
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + (y + 1) * voxelSize,	-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		-voxelSizeHalved + z * voxelSize));
-				Vertices.Add(FVector(chunkOffset + x * voxelSize,			chunkOffset + y * voxelSize,		voxelSizeHalved + z * voxelSize));
 
-				Normals.Append(bNormals5, UE_ARRAY_COUNT(bNormals5));
-				break;
+			const FVoxelMeshInformation& meshInformation = section.voxelMeshInformation[m];
+			int previousVertexCount = meshSectionVertexCounts[meshSectionIndex];
+			uint32 previousHash = meshSectionHashes[meshSectionIndex];
+			meshSectionVertexCounts[meshSectionIndex] = meshInformation.Vertices.Num();
+			meshSectionHashes[meshSectionIndex] = meshInformation.hash;
+
+			// Don't touch the render data of sections that didn't change at all.
+			if (previousVertexCount == meshInformation.Vertices.Num() && previousHash == meshInformation.hash) {
+				INC_DWORD_STAT(STAT_VoxelMeshSectionsUnchanged);
+				continue;
 			}
+
+			// The same vertex count means the same triangles, so only the vertex buffers need to be replaced.
+			if (previousVertexCount == meshInformation.Vertices.Num()) {
+				INC_DWORD_STAT(STAT_VoxelMeshSectionsUpdated);
+				proceduralComponent->UpdateMeshSection(
+					meshSectionIndex,
+					meshInformation.Vertices,
+					meshInformation.Normals,
+					meshInformation.UVs,
+					meshInformation.VertexColors,
+					meshInformation.Tangents
+				);
+				continue;
 			}
 
-			// Add the UVs and color informations to the faces.
-			UVs.Append(bUVs, UE_ARRAY_COUNT(bUVs));
-			FColor color = FColor(255, 255, 255, i);
-			VertexColors.Add(color);
-			VertexColors.Add(color);
-			VertexColors.Add(color);
-			VertexColors.Add(color);
+			INC_DWORD_STAT(STAT_VoxelMeshSectionsCreated);
+			proceduralComponent->CreateMeshSection(
+				meshSectionIndex,
+				meshInformation.Vertices,
+				meshInformation.Triangles,
+				meshInformation.Normals,
+				meshInformation.UVs,
+				meshInformation.VertexColors,
+				meshInformation.Tangents,
+				false
+			);
+
+			if (assetList[m] && assetList[m]->material)
+				proceduralComponent->SetMaterial(meshSectionIndex, assetList[m]->material);
+			else
+				PrintDebugWarning({
+					"Couldn't attach material.",
+					"Reason: No valid material for this voxel asset ID!",
+					"Voxel ID: " + FString::FromInt(m)
+					});
+		}
+
+		// Results built before the collision was toggled are ignored, a newer result follows.
+		if (!section.bHasCollision || !bCollisionEnabled)
+			continue;
+
+		// Only cook the collision again, if it changed.
+		const FVoxelMeshInformation& collision = section.collisionMeshInformation;
+		int collisionSectionIndex = GetCollisionSectionIndex(section.sectionIndex);
+		uint32 collisionHash = collision.Vertices.Num() > 0 ? collision.hash : 0;
+		if (collisionHash == collisionSectionHashes[section.sectionIndex])
+			continue;
+		collisionSectionHashes[section.sectionIndex] = collisionHash;
+
+		if (collision.Vertices.Num() == 0) {
+			if (collisionSectionIndex < proceduralComponent->GetNumSections())
+				proceduralComponent->ClearMeshSection(collisionSectionIndex);
+			continue;
 		}
-		numOfElements += numOfTriangle;
-		voxelMeshInformation[voxelAssetID].elementID += numOfTriangle;
-		#pragma endregion
+
+		proceduralComponent->CreateMeshSection(
+			collisionSectionIndex,
+			collision.Vertices,
+			collision.Triangles,
+			TArray<FVector>(),
+			TArray<FVector2D>(),
+			TArray<FColor>(),
+			TArray<FProcMeshTangent>(),
+			true
+		);
+		proceduralComponent->SetMeshSectionVisible(collisionSectionIndex, false);
 	}
+}
+
+FChunkMeshSnapshotPtr AChunkActor::CreateMeshSnapshot() {
+
+	TSharedPtr<FChunkMeshSnapshot, ESPMode::ThreadSafe> snapshot = MakeShared<FChunkMeshSnapshot, ESPMode::ThreadSafe>();
+	chunkData->voxelAssetIDs.CopyTo(snapshot->voxelAssetIDs);
+
+	// Uniform sections are packed for the mesher without walking their voxels.
+	snapshot->uniformSections.SetNumUninitialized(chunkData->voxelAssetIDs.GetNumOfSections());
+	for (int s = 0; s < chunkData->voxelAssetIDs.GetNumOfSections(); s++) {
+		snapshot->uniformSections[s] = chunkData->voxelAssetIDs.IsSectionUniform(s);
 	}
+	snapshot->voxelSize = voxelSize;
+	snapshot->voxelSizeHalved = voxelSizeHalved;
+	snapshot->chunkWidth = chunkWidth;
+	snapshot->chunkWidthSquared = chunkWidthSquared;
+	snapshot->chunkHeight = chunkHeight;
+	snapshot->chunkOffset = chunkOffset;
+	snapshot->sectionHeight = sectionHeight;
+	snapshot->bGreedyMeshing = bGreedyMeshing;
+	snapshot->vertexCountHints = meshSectionVertexCounts;
+	snapshot->lodLevel = lodLevel;
+	snapshot->bBuildCollision = bCollisionEnabled;
+	snapshot->bSimplifiedCollision = bSimplifiedCollision;
+
+	// Copy one border cell deep of every neighbour, so faces can be culled against the cells the neighbour shows.
+	// The mesher adds skirts towards neighbours with another cell size.
+	snapshot->skirtDepth = skirtDepth;
+	for (int face = 2; face < 6; face++) {
+		if (AChunkActor* neighbour = GetNeighbour(face)) {
+			int neighbourCellSize = FChunkMesher::GetCellSize(chunkWidth, neighbour->lodLevel);
+			snapshot->neighbourCellSizes[face - 2] = neighbourCellSize;
+			neighbour->CopyBorder(face ^ 1, neighbourCellSize, snapshot->neighbourBorders[face - 2]);
+		}
 	}
 
-	proceduralComponent->ClearAllMeshSections();
+	// Resolve the asset list here, because UObjects can't be touched by the mesher.
+	snapshot->validAssetIDs.SetNumZeroed(assetList.Num());
+	for (int i = 1; i < assetList.Num(); i++) {
+		snapshot->validAssetIDs[i] = assetList[i] != nullptr;
+	}
 
-	for (int i = 1; i < voxelMeshInformation.Num(); i++) {
-		if(voxelMeshInformation[i].Vertices.Num() > 0)
-			proceduralComponent->CreateMeshSection(
-				i, 
-				voxelMeshInformation[i].Vertices, 
-				voxelMeshInformation[i].Triangles, 
-				voxelMeshInformation[i].Normals, 
-				voxelMeshInformation[i].UVs, 
-				voxelMeshInformation[i].VertexColors, 
-				voxelMeshInformation[i].Tangents, 
-				true
-			);
+	// Hand over the dirty sections, they are clean from now on.
+	for (int s = 0; s < numOfSections; s++) {
+		if (dirtySections[s])
+			snapshot->dirtySections.Add(s);
 	}
+	dirtySections.Init(false, numOfSections);
+	return snapshot;
+}
 
-	for (int m = 1; m < assetList.Num(); m++){
-		if (assetList.IsValidIndex(m)){
-			if (assetList[m]) {
-				if (assetList[m]->material)
-					proceduralComponent->SetMaterial(m, assetList[m]->material);
-				else 
-					PrintDebugWarning({
-						"Couldn't attach material.",
-						"Reason: No valid material for this voxel asset ID!",
-						"Voxel ID: " + FString::FromInt(m)
-						});
-				
+void AChunkActor::MarkSectionDirty(int z) {
+
+	int section = z / sectionHeight;
+	if (dirtySections.IsValidIndex(section))
+		dirtySections[section] = true;
+
+	// Faces of the neighbouring section touch voxels on the section boundary.
+	if (z % sectionHeight == 0 && dirtySections.IsValidIndex(section - 1))
+		dirtySections[section - 1] = true;
+	if (z % sectionHeight == sectionHeight - 1 && dirtySections.IsValidIndex(section + 1))
+		dirtySections[section + 1] = true;
+}
+
+void AChunkActor::MarkAllSectionsDirty() {
+	dirtySections.Init(true, numOfSections);
+}
+
+void AChunkActor::MarkBorderDirty(int face) {
+
+	// Only sections with filled voxels in the border cells can have faces towards the neighbour.
+	int cellSize = FChunkMesher::GetCellSize(chunkWidth, lodLevel);
+	for (int z = 0; z < chunkHeight; z++) {
+		int section = z / sectionHeight;
+		if (dirtySections[section]) continue;
+
+		for (int layer = 0; layer < cellSize && !dirtySections[section]; layer++) {
+		for (int i = 0; i < chunkWidth; i++) {
+			if (chunkData->voxelAssetIDs.Get(GetBorderIndex(face, i, z, layer)) >= 1) {
+				dirtySections[section] = true;
+				break;
 			}
 		}
+		}
+	}
+}
+
+void AChunkActor::CopyBorder(int face, int numOfLayers, TArray<int>& border) const {
+
+	border.SetNumUninitialized(chunkWidth * chunkHeight * numOfLayers);
+	for (int layer = 0; layer < numOfLayers; layer++) {
+	for (int z = 0; z < chunkHeight; z++) {
+	for (int i = 0; i < chunkWidth; i++) {
+		border[i + z * chunkWidth + layer * chunkWidth * chunkHeight] = chunkData->voxelAssetIDs.Get(GetBorderIndex(face, i, z, layer));
+	}
+	}
+	}
+}
+
+int AChunkActor::GetBorderIndex(int face, int i, int z, int layer) const {
+
+	// The border layers are indexed by X for the Y faces and by Y for the X faces.
+	switch (face) {
+	case 2: return i + (chunkWidth - 1 - layer) * chunkWidth + z * chunkWidthSquared;
+	case 3: return i + layer * chunkWidth + z * chunkWidthSquared;
+	case 4: return (chunkWidth - 1 - layer) + i * chunkWidth + z * chunkWidthSquared;
+	default: return layer + i * chunkWidth + z * chunkWidthSquared;
 	}
-	return true;
 }
 
+AChunkActor* AChunkActor::GetNeighbour(int face) const {
+
+	// Only the horizontal faces have neighbours.
+	if (face < 2 || face > 5) return nullptr;
+
+	AChunkManager* manager = Cast<AChunkManager>(GetOwner());
+	if (!manager) return nullptr;
+
+	const FIntPoint offsets[] = { FIntPoint(0, 1), FIntPoint(0, -1), FIntPoint(1, 0), FIntPoint(-1, 0) };
+	AChunkActor* neighbour = manager->GetChunk(chunkCoordinates + offsets[face - 2]);
+
+	// Neighbours without voxels or with a different size can't be used for culling.
+	if (!neighbour || neighbour == this || !neighbour->bGenerated) return nullptr;
+	if (neighbour->chunkWidth != chunkWidth || neighbour->chunkHeight != chunkHeight) return nullptr;
+	return neighbour;
+}
+
+
 /// ------ Debug ------ \\\
 
 void AChunkActor::PrintDebugWarning(TArray<FString> information) {
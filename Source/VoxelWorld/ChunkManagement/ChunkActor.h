@@ -6,20 +6,12 @@
 #include "ProceduralMeshComponent.h"
 #include "../Libraries/SimplexNoiseLibrary.h"
 #include "../Assets/VoxelAsset.h"
+#include "ChunkMesher.h"
+#include "VoxelWorldStore.h"
+#include "VoxelColumnGenerator.h"
 #include "GameFramework/Actor.h"
 #include "ChunkActor.generated.h"
 
-/* This struct stores all necessary information to create a procedural mesh. */
-struct FVoxelMeshInformation {
-	TArray<FVector> Vertices;
-	TArray<int> Triangles;
-	TArray<FVector> Normals;
-	TArray<FVector2D> UVs;
-	TArray<FColor> VertexColors;
-	TArray<FProcMeshTangent> Tangents;
-	int elementID = 0;
-};
-
 UCLASS()
 class VOXELWORLD_API AChunkActor : public AActor
 {
@@ -43,25 +35,49 @@ protected:
 	UPROPERTY()
 		UProceduralMeshComponent* proceduralComponent;
 
+	// The revision of the latest requested mesh.
+	int meshRevision = 0;
+
+	// The revision of the latest uploaded mesh for every vertical section.
+	TArray<int> appliedSectionRevisions;
+
+	// The vertical sections whose mesh needs to be rebuilt.
+	TBitArray<> dirtySections;
+
+	// The vertex count of every procedural mesh section. Used to reserve the buffers of the next build.
+	TArray<int> meshSectionVertexCounts;
+
+	// The checksum of the vertex data of every procedural mesh section. Unchanged sections aren't uploaded again.
+	TArray<uint32> meshSectionHashes;
+
+	// The checksum of the collision mesh of every vertical section. Zero, if the section has no collision.
+	TArray<uint32> collisionSectionHashes;
+
+	// The number of heap allocations the latest uploaded mesh build needed.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|Debug")
+		int lastMeshBuildAllocations = 0;
+
 public:
 	UPROPERTY()
 		FVector2D assignedRegion = FVector2D(0, 0);
 
-	// The stored asset IDs of voxels inside the chunk. 
-	UPROPERTY(BlueprintReadOnly, Category = "Settings|Voxel")
-		TArray<int> voxelAssetIDs;
+	// The voxels and save state of the chunk. Shared with the world store of the owning chunk manager.
+	FVoxelChunkDataPtr chunkData;
 
-	TArray<int> GetVoxelAssetIDs() {
-		return voxelAssetIDs;
+	// Decode the asset IDs of every voxel inside the chunk.
+	TArray<int> GetVoxelAssetIDs() const {
+		TArray<int> voxels;
+		chunkData->voxelAssetIDs.CopyTo(voxels);
+		return voxels;
 	};
 
-	// Should this chunk be saved with the next save command. 
+	// Has the chunk been set up for rendering its voxels.
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Voxel")
-		bool markedForSaving = false;
+		bool bGenerated = false;
 
-	// The stored asset IDs of voxels inside the chunk. 
-	UPROPERTY(BlueprintReadOnly, Category = "Settings|Voxel")
-		TSet<int> voxelAssetChanged;
+	// Should coplanar faces of the same asset be merged into larger quads.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Settings|Voxel")
+		bool bGreedyMeshing = false;
 
 /// ------ Size ------ \\\
 
@@ -78,6 +94,14 @@ public:
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Size")
 		int chunkHeight = 128;
 
+	// The height of a single vertical section in voxels. Sections are meshed independently.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|Size")
+		int sectionHeight = 16;
+
+	// The number of vertical sections inside the chunk.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|Size")
+		int numOfSections = 8;
+
 protected:
 	// The size of a single voxel divided by two. This precalculation increases performance.
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Size")
@@ -86,6 +110,28 @@ protected:
 	// The squared value of the chunk width. This precalculation increases performance.
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Size")
 		int chunkWidthSquared = 256;
+
+/// ------ Level of detail ------ \\\
+
+public:
+	// The current level of detail. Every level doubles the size of the meshed cells.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|LOD")
+		int lodLevel = 0;
+
+	// The depth in cells of the skirts, which hide the seams towards chunks with another level of detail.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Settings|LOD", Meta = (ClampMin = 1, ClampMax = 16))
+		int skirtDepth = 2;
+
+/// ------ Collision ------ \\\
+
+public:
+	// Does the chunk build collision. Set by the chunk manager for chunks close to a player.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|Collision")
+		bool bCollisionEnabled = true;
+
+	// Should the collision merge the visible faces of every asset into greedy quads instead of using the render triangles.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Settings|Collision")
+		bool bSimplifiedCollision = true;
 	
 /// ------ Position ------ \\\
 	
@@ -104,6 +150,10 @@ public:
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Position")
 		int chunkIndexY = 0;
 
+	// The X and Y index of the chunk in the world.
+	UPROPERTY(BlueprintReadOnly, Category = "Settings|Position")
+		FIntPoint chunkCoordinates = FIntPoint(0, 0);
+
 protected:
 	// The relative offset around the chunk center.
 	UPROPERTY(BlueprintReadOnly, Category = "Settings|Position")
@@ -124,6 +174,9 @@ protected:
 	UPROPERTY()
 		TArray<FString> defaultInformation = {"None"};
 
+	// The native generator filling the columns of the chunk. Shared by every chunk of the manager.
+	FVoxelColumnGeneratorPtr columnGenerator;
+
 
 
 /// ------ FUNCTIONS ------ \\\
@@ -144,10 +197,27 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Initialization", Meta = ( Keywords = "Init, Create, Initialize, Chunk, Set, Variables" ))
 		void Initialize(TArray<UVoxelAsset*> _assetList, int _voxelSize, int _chunkWidth, int _chunkHeight, FVector2D _position, int _regionSize);
 
+	// Render the given chunk data instead of the chunk's own voxels. Data that wasn't generated yet is sized for this chunk.
+	// Has to be called after the initialization and before the generation.
+	// @param data - The chunk data from the world store.
+	// @return - VOID
+	void SetChunkData(const FVoxelChunkDataPtr& data);
+
+	// Fill the voxels natively column by column instead of calling the noise and voxel distribution events.
+	// Has to be called before the generation.
+	// @param generator - The column generator or nullptr to use the events.
+	// @return - VOID
+	void SetColumnGenerator(const FVoxelColumnGeneratorPtr& generator);
+
+	// Remove the mesh and release the voxels, so the chunk can be initialized again for other coordinates.
+	// The procedural mesh component is kept and reused by the next generation.
+	// @return - VOID
+	void ReleaseChunk();
+
 /// ------ Generation ------ \\\
 
 public:
-	// Generate the chunk for the first time or after destruction.
+	// Generate the chunk for the first time or after destruction. Voxels that are already stored are only meshed.
 	// @return - Did the generation succeed?
 	UFUNCTION(BlueprintCallable, Category = "Generation", Meta = ( Keywords = "generate, generation, Chunk, new, creation" ))
 		bool GenerateChunk();
@@ -156,7 +226,31 @@ public:
 	// @return - Did the generation succeed?
 	bool GenerateChunk(const TMap<int,int>& chunkMap);
 
+	// Set up the procedural mesh and calculate the noise of every column, if the voxels still have to be generated.
+	// Runs on the game thread, because the noise may be calculated in Blueprints.
+	// @param noise - The noise value of every column. Empty, if the voxels are already stored or a column generator is set.
+	// @return - VOID
+	void PrepareGeneration(TArray<int>& noise);
+
+	// Check, if the voxels can be filled on any thread. Only the column generator and the native voxel distribution are thread safe.
+	// @return - Is a column generator set or the voxel distribution not overridden in Blueprints?
+	bool CanFillVoxelsInParallel() const;
+
+	// Fill the voxels of the chunk from the noise. Different chunks can be filled in parallel, if CanFillVoxelsInParallel is true.
+	// @param noise - The noise value of every column. Ignored, if a column generator is set.
+	// @return - VOID
+	void FillVoxels(const TArray<int>& noise);
+
+	// Request the mesh of the filled voxels and let the neighbours cull the faces towards the chunk.
+	// @param generatedTogether - The coordinates of chunks generated in the same batch. They already see the voxels of this chunk.
+	// @return - Did the generation succeed?
+	bool FinishGeneration(const TSet<FIntPoint>* generatedTogether = nullptr);
+
 protected:
+	// Create the procedural mesh component or show the one of a recycled chunk.
+	// @return - VOID
+	void SetupMeshComponent();
+
 	// Calculate the corresponding noise to the x and y position.
 	// @param x - The relativ X position for the calculation.
 	// @param y - The relativ Y position for the calculation.
@@ -169,10 +263,19 @@ protected:
 	// @param z - The relative z position of the current voxel.
 	// @param noise - The noise value (height variation) of the current voxel.
 	// @return - The voxel asset ID for the current height.
+	// The native implementation must be pure, because it is only evaluated once per height and distinct noise value. Blueprint overrides are called for every voxel.
 	UFUNCTION(BlueprintNativeEvent, Category = "Generation", Meta = ( BlueprintProtected ))
 		int VoxelAssetDistribution(const int& z, const int& noise);
 	virtual int VoxelAssetDistribution_Implementation(const int& z, const int& noise);
 
+	// Calculate the asset ID of every voxel inside the chunk. Sections with a single asset ID are stored without their voxels.
+	// @param dims - The dimensions of the chunk, either specialised at compile time or the runtime fallback.
+	// @param noise - The noise value (height variation) of every column. The column key, if a column generator is set.
+	// @param bNativeDistribution - Call the native voxel distribution directly instead of the event. Needed outside the game thread.
+	// @return - VOID
+	template<typename TDims>
+	void GenerateVoxels(const TDims& dims, const TArray<int>& noise, bool bNativeDistribution);
+
 /// ------ Chunk update ------ \\\
 
 protected:
@@ -189,11 +292,99 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Update", Meta = ( Keywords = "Replace, Set, Voxel, Cube, Chunk, Update" ))
 		bool ReplaceVoxel(FVector position, int value);
 
+	// Replace a voxel (cube) inside the chunk and update the touching neighbours.
+	// @param x - The X position inside the chunk.
+	// @param y - The Y position inside the chunk.
+	// @param z - The Z position inside the chunk.
+	// @param voxelID - The ID of the new voxel type.
+	// @return - Did the replacement succeed?
+	bool ReplaceVoxelAt(int x, int y, int z, int voxelID);
+
 	// Update the procedural mesh by recalculating every verticy.
 	// @return - Did the update succeed?
 	UFUNCTION(BlueprintCallable, Category = "Update", Meta = ( Keywords = "Renew, New, Voxel, Cube, Chunk, Update, Mesh, Actor, Object" ))
 		bool UpdateMesh();
 
+	// Request a mesh update, which is built in the background and uploaded by the owning chunk manager.
+	// Falls back to a synchronous update, if the chunk isn't owned by a chunk manager.
+	// @return - Did the request succeed?
+	UFUNCTION(BlueprintCallable, Category = "Update", Meta = ( Keywords = "Renew, New, Async, Background, Chunk, Update, Mesh" ))
+		bool RequestMeshUpdate();
+
+	// Change the level of detail and request a new mesh, if it differs from the current one.
+	// @param level - The new level of detail. Zero is the full resolution.
+	// @return - Did the level of detail change?
+	UFUNCTION(BlueprintCallable, Category = "Update", Meta = ( Keywords = "LOD, Level, Detail, Distance, Chunk, Update, Mesh" ))
+		bool SetLODLevel(int level);
+
+	// Enable or disable the collision of the chunk. Enabling it requests a new mesh, disabling it removes the collision right away.
+	// @param bEnabled - Should the chunk have collision?
+	// @return - VOID
+	UFUNCTION(BlueprintCallable, Category = "Update", Meta = ( Keywords = "Collision, Physics, Enable, Disable, Chunk" ))
+		void SetChunkCollision(bool bEnabled);
+
+	// Upload a finished mesh to the procedural mesh component. Outdated results are ignored.
+	// @param result - The finished mesh build.
+	// @return - VOID
+	void ApplyMeshUpdate(const FChunkMeshResult& result);
+
+protected:
+	// Create an immutable copy of everything the mesher needs. The dirty sections are handed over and marked clean.
+	// @return - The snapshot of the current chunk state.
+	FChunkMeshSnapshotPtr CreateMeshSnapshot();
+
+	// Mark the vertical section of the given height for remeshing. Includes the neighbouring section, if the height is on the boundary.
+	// @param z - The Z position of the changed voxel.
+	// @return - VOID
+	void MarkSectionDirty(int z);
+
+	// Mark every vertical section for remeshing.
+	// @return - VOID
+	void MarkAllSectionsDirty();
+
+public:
+	// Mark every vertical section with filled voxels in the border cells of the given side for remeshing.
+	// @param face - The index of the face (+Y, -Y, +X, -X) pointing towards the changed neighbour.
+	// @return - VOID
+	void MarkBorderDirty(int face);
+
+	// Copy the outer voxel layers of the given side.
+	// @param face - The index of the face (+Y, -Y, +X, -X) of the layers.
+	// @param numOfLayers - The number of layers, starting with the outer one.
+	// @param border - The copied asset IDs, indexed by the horizontal position plus Z times the chunk width plus the layer times the layer size.
+	// @return - VOID
+	void CopyBorder(int face, int numOfLayers, TArray<int>& border) const;
+
+protected:
+
+	// Find the generated neighbour chunk on the given side.
+	// @param face - The index of the face (+Y, -Y, +X, -X) pointing towards the neighbour.
+	// @return - The neighbour chunk or nullptr.
+	AChunkActor* GetNeighbour(int face) const;
+
+	// Calculate the voxel index on a border layer of the given side.
+	// @param face - The index of the face (+Y, -Y, +X, -X) of the layer.
+	// @param i - The X position for the Y faces or the Y position for the X faces.
+	// @param z - The Z position.
+	// @param layer - The distance of the layer from the outer one.
+	// @return - The index of the voxel.
+	int GetBorderIndex(int face, int i, int z, int layer = 0) const;
+
+	// Calculate the index of the procedural mesh section for a voxel asset inside a vertical section.
+	// @param section - The index of the vertical section.
+	// @param assetID - The voxel asset ID.
+	// @return - The index of the procedural mesh section.
+	int GetMeshSectionIndex(int section, int assetID) const {
+		return section * assetList.Num() + assetID;
+	}
+
+	// Calculate the index of the invisible procedural mesh section holding the collision of a vertical section.
+	// @param section - The index of the vertical section.
+	// @return - The index of the procedural mesh section.
+	int GetCollisionSectionIndex(int section) const {
+		return numOfSections * assetList.Num() + section;
+	}
+
 /// ------ Debug ------ \\\
 
 protected:
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkDimensions.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarVoxelForceDynamicChunkDims(
+	TEXT("voxel.ForceDynamicChunkDims"),
+	0,
+	TEXT("Use the runtime chunk dimensions (1) instead of the compile time specialisations (0). Compare both with \"stat VoxelWorld\"."),
+	ECVF_Default);
+
+bool ShouldForceDynamicChunkDims() {
+	return CVarVoxelForceDynamicChunkDims.GetValueOnAnyThread() != 0;
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Check, if the hot loops should always use the runtime dimensions. Set with "voxel.ForceDynamicChunkDims".
+bool ShouldForceDynamicChunkDims();
+
+/* Chunk dimensions known at compile time. Indices are calculated with shifts and the loop bounds are constant. */
+template<int Width, int Height>
+struct TStaticChunkDims {
+
+	static_assert(Width > 0 && (Width & (Width - 1)) == 0, "The chunk width has to be a power of two.");
+	static_assert(Height > 0 && (Height & (Height - 1)) == 0, "The chunk height has to be a power of two.");
+
+	// Calculate the binary logarithm of a power of two.
+	static constexpr int Log2(int value) {
+		return value <= 1 ? 0 : 1 + Log2(value >> 1);
+	}
+
+	static constexpr bool bStatic = true;
+	static constexpr int WidthShift = Log2(Width);
+
+	FORCEINLINE int GetWidth() const { return Width; }
+	FORCEINLINE int GetHeight() const { return Height; }
+	FORCEINLINE int GetWidthSquared() const { return Width * Width; }
+	FORCEINLINE int GetNumOfWords() const { return (Height + 63) >> 6; }
+
+	// Calculate the index of a column inside a layer.
+	FORCEINLINE int GetColumn(int x, int y) const {
+		return x | (y << WidthShift);
+	}
+
+	// Calculate the index of a voxel.
+	FORCEINLINE int GetIndex(int x, int y, int z) const {
+		return x | (y << WidthShift) | (z << (WidthShift * 2));
+	}
+};
+
+/* Chunk dimensions only known at runtime. Used for every size without a specialisation. */
+struct FDynamicChunkDims {
+
+	static constexpr bool bStatic = false;
+
+	int width;
+	int height;
+	int widthSquared;
+
+	FDynamicChunkDims(int width, int height)
+		: width(width)
+		, height(height)
+		, widthSquared(width * width)
+	{}
+
+	FORCEINLINE int GetWidth() const { return width; }
+	FORCEINLINE int GetHeight() const { return height; }
+	FORCEINLINE int GetWidthSquared() const { return widthSquared; }
+	FORCEINLINE int GetNumOfWords() const { return (height + 63) / 64; }
+
+	// Calculate the index of a column inside a layer.
+	FORCEINLINE int GetColumn(int x, int y) const {
+		return x + y * width;
+	}
+
+	// Calculate the index of a voxel.
+	FORCEINLINE int GetIndex(int x, int y, int z) const {
+		return x + y * width + z * widthSquared;
+	}
+};
+
+// Call the given function with the specialised dimensions of the common chunk sizes or with the runtime fallback.
+// @param width - The width of the chunk in voxels.
+// @param height - The height of the chunk in voxels.
+// @param function - A generic function receiving the dimensions.
+// @return - VOID
+template<typename Function>
+FORCEINLINE void DispatchChunkDims(int width, int height, Function&& function) {
+
+	if (!ShouldForceDynamicChunkDims()) {
+		if (width == 16 && height == 128) {
+			function(TStaticChunkDims<16, 128>());
+			return;
+		}
+		if (width == 32 && height == 256) {
+			function(TStaticChunkDims<32, 256>());
+			return;
+		}
+	}
+	function(FDynamicChunkDims(width, height));
+}
@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Maps chunk coordinates to values without hashing. Chunks inside a square window around the origin are stored in a
+   ring buffer, which is indexed by the coordinates modulo the window size. Moving the origin only touches the cells
+   that leave or enter the window. Chunks outside of the window are kept in a sparse fallback map. */
+template<typename ValueType>
+class TChunkGrid {
+
+public:
+	// Resize the window. Every stored value is kept.
+	// @param _radius - The number of chunks from the origin to the border of the window.
+	// @return - VOID
+	void Init(int _radius) {
+
+		TArray<TPair<FIntPoint, ValueType>> values;
+		ForEach([&](const FIntPoint& coordinates, ValueType& value) {
+			values.Emplace(coordinates, MoveTemp(value));
+		});
+
+		radius = FMath::Max(_radius, 0);
+		size = radius * 2 + 1;
+		cells.Empty(size * size);
+		cells.SetNum(size * size);
+		outside.Empty();
+		num = 0;
+
+		for (TPair<FIntPoint, ValueType>& value : values) {
+			Add(value.Key, MoveTemp(value.Value));
+		}
+	}
+
+	// Move the window, so it is centred on the given coordinates.
+	// @param _origin - The X and Y index of the new centre chunk.
+	// @return - VOID
+	void SetOrigin(const FIntPoint& _origin) {
+
+		if (_origin == origin) return;
+		origin = _origin;
+
+		// Cells keep their position inside the ring buffer, so only values leaving the window move to the fallback map.
+		for (FCell& cell : cells) {
+			if (cell.bUsed && !IsInWindow(cell.coordinates)) {
+				outside.Add(cell.coordinates, MoveTemp(cell.value));
+				cell.value = ValueType();
+				cell.bUsed = false;
+			}
+		}
+
+		// Values entering the window move into their cells.
+		for (auto iterator = outside.CreateIterator(); iterator; ++iterator) {
+			if (!IsInWindow(iterator.Key())) continue;
+
+			FCell& cell = cells[GetCellIndex(iterator.Key())];
+			cell.coordinates = iterator.Key();
+			cell.value = MoveTemp(iterator.Value());
+			cell.bUsed = true;
+			iterator.RemoveCurrent();
+		}
+	}
+
+	// The X and Y index of the centre chunk of the window.
+	const FIntPoint& GetOrigin() const {
+		return origin;
+	}
+
+	// Find the value of a chunk.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The value or nullptr, if none is stored for the chunk.
+	FORCEINLINE ValueType* Find(const FIntPoint& coordinates) {
+		if (!IsInWindow(coordinates))
+			return outside.Find(coordinates);
+
+		FCell& cell = cells[GetCellIndex(coordinates)];
+		return cell.bUsed ? &cell.value : nullptr;
+	}
+
+	FORCEINLINE const ValueType* Find(const FIntPoint& coordinates) const {
+		return const_cast<TChunkGrid*>(this)->Find(coordinates);
+	}
+
+	// Find the value of a chunk.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - A copy of the value or the default value, if none is stored for the chunk.
+	FORCEINLINE ValueType FindRef(const FIntPoint& coordinates) const {
+		const ValueType* value = Find(coordinates);
+		return value ? *value : ValueType();
+	}
+
+	// Store the value of a chunk. Replaces any previous value.
+	// @param coordinates - The X and Y index of the chunk.
+	// @param value - The new value.
+	// @return - The stored value.
+	ValueType& Add(const FIntPoint& coordinates, ValueType value) {
+
+		if (!IsInWindow(coordinates)) {
+			if (!outside.Contains(coordinates))
+				num++;
+			return outside.Add(coordinates, MoveTemp(value));
+		}
+
+		FCell& cell = cells[GetCellIndex(coordinates)];
+		if (!cell.bUsed)
+			num++;
+		cell.coordinates = coordinates;
+		cell.value = MoveTemp(value);
+		cell.bUsed = true;
+		return cell.value;
+	}
+
+	// Remove the value of a chunk.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - Was a value stored for the chunk?
+	bool Remove(const FIntPoint& coordinates) {
+
+		if (!IsInWindow(coordinates)) {
+			if (outside.Remove(coordinates) == 0) return false;
+			num--;
+			return true;
+		}
+
+		FCell& cell = cells[GetCellIndex(coordinates)];
+		if (!cell.bUsed) return false;
+		cell.value = ValueType();
+		cell.bUsed = false;
+		num--;
+		return true;
+	}
+
+	// Remove every value. The window keeps its size and origin.
+	void Empty() {
+		for (FCell& cell : cells) {
+			cell = FCell();
+		}
+		outside.Empty();
+		num = 0;
+	}
+
+	// The number of stored values.
+	int Num() const {
+		return num;
+	}
+
+	// Call the given function for every stored value. Values must not be added or removed meanwhile.
+	// @param function - A function receiving the coordinates and the value.
+	// @return - VOID
+	template<typename Function>
+	void ForEach(Function&& function) {
+		for (FCell& cell : cells) {
+			if (cell.bUsed)
+				function(const_cast<const FIntPoint&>(cell.coordinates), cell.value);
+		}
+		for (TPair<FIntPoint, ValueType>& pair : outside) {
+			function(const_cast<const FIntPoint&>(pair.Key), pair.Value);
+		}
+	}
+
+	template<typename Function>
+	void ForEach(Function&& function) const {
+		const_cast<TChunkGrid*>(this)->ForEach([&](const FIntPoint& coordinates, ValueType& value) {
+			function(coordinates, const_cast<const ValueType&>(value));
+		});
+	}
+
+	// The memory used by the window and the fallback map in bytes.
+	SIZE_T GetAllocatedSize() const {
+		return cells.GetAllocatedSize() + outside.GetAllocatedSize();
+	}
+
+private:
+	// Check, if the chunk is inside the window.
+	FORCEINLINE bool IsInWindow(const FIntPoint& coordinates) const {
+		return FMath::Abs(coordinates.X - origin.X) <= radius && FMath::Abs(coordinates.Y - origin.Y) <= radius;
+	}
+
+	// Calculate the ring buffer cell of a chunk inside the window.
+	FORCEINLINE int GetCellIndex(const FIntPoint& coordinates) const {
+		int x = coordinates.X % size;
+		int y = coordinates.Y % size;
+		if (x < 0) x += size;
+		if (y < 0) y += size;
+		return x + y * size;
+	}
+
+	struct FCell {
+
+		// The X and Y index of the stored chunk.
+		FIntPoint coordinates = FIntPoint(0, 0);
+
+		// The value of the stored chunk.
+		ValueType value = ValueType();
+
+		// Is a chunk stored inside the cell.
+		bool bUsed = false;
+	};
+
+	// The ring buffer of the window.
+	TArray<FCell> cells = { FCell() };
+
+	// The values of chunks outside of the window.
+	TMap<FIntPoint, ValueType> outside;
+
+	// The X and Y index of the centre chunk of the window.
+	FIntPoint origin = FIntPoint(0, 0);
+
+	// The number of chunks from the origin to the border of the window.
+	int radius = 0;
+
+	// The number of chunks along a side of the window.
+	int size = 1;
+
+	// The number of stored values.
+	int num = 0;
+};
@@ -5,20 +5,58 @@
 #include "Widgets/Notifications/SNotificationList.h"
 #include "Editor/EditorStyle/Public/EditorStyleSet.h"
 #include "Runtime/Engine/Public/TimerManager.h"
+#include "GameFramework/PlayerController.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
 
 
 // Sets default values
 AChunkManager::AChunkManager() {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+
+	meshResultQueue = MakeShared<FChunkMeshResultQueue, ESPMode::ThreadSafe>();
 }
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunks Spawned"), STAT_VoxelChunksSpawned, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunks Recycled"), STAT_VoxelChunksRecycled, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Spawn Chunks"), STAT_VoxelSpawnChunks, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Fill Voxels"), STAT_VoxelFillVoxels, STATGROUP_VoxelWorld);
+
+static TAutoConsoleVariable<int32> CVarVoxelParallelGeneration(
+	TEXT("voxel.ParallelGeneration"),
+	1,
+	TEXT("Fill the voxels of chunks spawned together on every core (1) or on the game thread only (0). Compare both with \"stat VoxelWorld\"."),
+	ECVF_Default);
+
 #define LOCTEXT_NAMESPACE "FChunkManager"
 
+// Calculate the distance in chunks to the nearest of the given chunks.
+static int GetChunkDistance(const TArray<FIntPoint>& centres, const FIntPoint& coordinates) {
+
+	// The distance is measured in whole chunks, so rings around a player share one value.
+	int distance = MAX_int32;
+	for (const FIntPoint& centre : centres) {
+		FIntPoint offset = coordinates - centre;
+		distance = FMath::Min(distance, FMath::Max(FMath::Abs(offset.X), FMath::Abs(offset.Y)));
+	}
+	return distance;
+}
+
 
 // Called when the game starts or when spawned
 void AChunkManager::BeginPlay() {
 
+	chunks.Init(gridRadius);
+	worldStore.Init(gridRadius);
+
+	// Resolve the generator asset once, the chunks share the result on every thread.
+	if (generatorAsset)
+		columnGenerator = generatorAsset->CreateColumnGenerator(randomseed);
+
+	// Chunks spawned right away already get the detail of their distance to the players.
+	UpdatePlayerChunks();
+
 	//GenerateWorldFromSave("DefaultWorld");
 	GenerateNewWorld();
 
@@ -77,11 +115,25 @@ void AChunkManager::ReshuffleAssetList()
 
 void AChunkManager::GenerateNewWorld_Implementation(){
 	if (!IsValid(chunkClass)) return;
+
+	// The first chunks around the players are spawned right away in a single batch.
+	if (bStreamChunks) {
+		UpdateStreaming();
+		TArray<FIntPoint> initialChunks;
+		while (chunkLoadQueue.Num() > 0) {
+			initialChunks.Add(chunkLoadQueue.Pop(false));
+		}
+		SpawnChunks(initialChunks);
+		return;
+	}
+
+	TArray<FIntPoint> initialChunks;
 	for (int x = -5; x <= 5; x++) {
 		for (int y = -5; y <= 5; y++) {
-			SpawnChunk(FVector2D(x, y));
+			initialChunks.Add(FIntPoint(x, y));
 		}
 	}
+	SpawnChunks(initialChunks);
 }
 
 
@@ -121,26 +173,140 @@ void AChunkManager::WorldLoadedCallback(FWorldInformation world, TArray<FChunkIn
 
 void AChunkManager::SetVoxel(FVector position, int value){
 	FVector chunkPosition = position / (voxelSize * chunkWidth);
-	AChunkActor* selectedChunk = chunks.FindRef(FVector2D(FMath::RoundToInt(chunkPosition.X), FMath::RoundToInt(chunkPosition.Y)));
+	AChunkActor* selectedChunk = chunks.FindRef(FIntPoint(FMath::RoundToInt(chunkPosition.X), FMath::RoundToInt(chunkPosition.Y)));
 
 	if (!selectedChunk) return;
 
 	selectedChunk->ReplaceVoxel(position, value);
 }
 
+bool AChunkManager::SetVoxel(const FIntVector& voxel, int value) {
+
+	FIntVector localVoxel;
+	FIntPoint coordinates = GetChunkCoordinates(voxel, localVoxel);
+	if (localVoxel.Z < 0 || localVoxel.Z >= chunkHight) return false;
+
+	// Spawned chunks update their mesh and their neighbours.
+	AChunkActor* chunk = chunks.FindRef(coordinates);
+	if (chunk && chunk->bGenerated)
+		return chunk->ReplaceVoxelAt(localVoxel.X, localVoxel.Y, localVoxel.Z, value);
+
+	// Chunks that are only loaded just store the new voxel.
+	FVoxelChunkDataPtr data = worldStore.Find(coordinates);
+	if (!data || !data->bGenerated) return false;
+	if (value != 0 && (!AssetList.IsValidIndex(value) || !AssetList[value])) return false;
+
+	data->voxelAssetIDs.Set(localVoxel.X, localVoxel.Y, localVoxel.Z, value);
+	data->markedForSaving = true;
+	data->bModified = true;
+	data->voxelAssetChanged.Add(localVoxel.X + localVoxel.Y * chunkWidth + localVoxel.Z * chunkWidth * chunkWidth);
+	return true;
+}
+
+int AChunkManager::GetVoxel(FVector position) const {
+	return GetVoxel(GetVoxelCoordinates(position));
+}
+
+int AChunkManager::GetVoxel(const FIntVector& voxel) const {
+
+	FIntVector localVoxel;
+	FIntPoint coordinates = GetChunkCoordinates(voxel, localVoxel);
+	if (localVoxel.Z < 0 || localVoxel.Z >= chunkHight) return -1;
+
+	FVoxelChunkDataPtr data = worldStore.Find(coordinates);
+	if (!data || !data->bGenerated) return -1;
+	return data->voxelAssetIDs.Get(localVoxel.X, localVoxel.Y, localVoxel.Z);
+}
+
+FIntVector AChunkManager::GetVoxelCoordinates(FVector position) const {
+
+	// The voxels are centred on the chunk position horizontally and on the voxel height vertically.
+	return FIntVector(
+		FMath::FloorToInt(position.X / voxelSize),
+		FMath::FloorToInt(position.Y / voxelSize),
+		FMath::FloorToInt((position.Z + voxelSize / 2) / voxelSize)
+	);
+}
+
+FIntPoint AChunkManager::GetChunkCoordinates(const FIntVector& voxel, FIntVector& localVoxel) const {
+
+	// The chunk at the origin spans from minus half its width to half its width.
+	int halfWidth = chunkWidth / 2;
+	int x = voxel.X + halfWidth;
+	int y = voxel.Y + halfWidth;
+	FIntPoint coordinates(
+		x >= 0 ? x / chunkWidth : (x - chunkWidth + 1) / chunkWidth,
+		y >= 0 ? y / chunkWidth : (y - chunkWidth + 1) / chunkWidth
+	);
+	localVoxel = FIntVector(x - coordinates.X * chunkWidth, y - coordinates.Y * chunkWidth, voxel.Z);
+	return coordinates;
+}
+
+AChunkActor* AChunkManager::GetChunk(const FIntPoint& coordinates) const {
+	return chunks.FindRef(coordinates);
+}
+
 void AChunkManager::SpawnChunk(const FVector2D& position)
 {
-	AChunkActor* chunk = GetWorld()->SpawnActorDeferred<AChunkActor>(
-		chunkClass,
-		FTransform(FVector(position.X * voxelSize * chunkWidth, position.Y * voxelSize * chunkWidth, 0)),
-		this,
-		nullptr,
-		ESpawnActorCollisionHandlingMethod::AlwaysSpawn
-		);
+	PrepareChunk(FIntPoint(FMath::RoundToInt(position.X), FMath::RoundToInt(position.Y)))->GenerateChunk();
+}
+
+AChunkActor* AChunkManager::PrepareChunk(const FIntPoint& coordinates) {
+
+	FVector2D position(coordinates.X, coordinates.Y);
+	AChunkActor* chunk = AcquireChunk(FTransform(FVector(position.X * voxelSize * chunkWidth, position.Y * voxelSize * chunkWidth, 0)));
 	chunk->Initialize(AssetList, voxelSize, chunkWidth, chunkHight, FVector2D(position.X, position.Y), 16);
-	chunks.Add(FVector2D(position.X, position.Y), chunk);
-	chunk->FinishSpawning(FTransform(FVector(position.X * voxelSize * chunkWidth, position.Y * voxelSize * chunkWidth, 0)), true, nullptr);
-	chunk->GenerateChunk();
+	chunk->SetChunkData(worldStore.FindOrAdd(coordinates));
+	chunk->SetColumnGenerator(columnGenerator);
+	chunks.Add(coordinates, chunk);
+	spawnedChunks.Add(chunk);
+	if (!chunk->IsActorInitialized())
+		chunk->FinishSpawning(FTransform(FVector(position.X * voxelSize * chunkWidth, position.Y * voxelSize * chunkWidth, 0)), true, nullptr);
+	UpdateChunkDetail(chunk);
+	return chunk;
+}
+
+void AChunkManager::SpawnChunks(const TArray<FIntPoint>& coordinatesList) {
+
+	SCOPE_CYCLE_COUNTER(STAT_VoxelSpawnChunks);
+	if (!IsValid(chunkClass)) return;
+
+	// Spawn the chunks and calculate their noise on the game thread, because both may run Blueprint code.
+	// Chunks with a column generator calculate their heights while filling their voxels instead.
+	TArray<AChunkActor*> newChunks;
+	TArray<TArray<int>> noise;
+	TSet<FIntPoint> generatedTogether;
+	for (const FIntPoint& coordinates : coordinatesList) {
+		if (chunks.Find(coordinates) || generatedTogether.Contains(coordinates)) continue;
+
+		AChunkActor* chunk = PrepareChunk(coordinates);
+		chunk->PrepareGeneration(noise.AddDefaulted_GetRef());
+		newChunks.Add(chunk);
+		generatedTogether.Add(coordinates);
+	}
+	if (newChunks.Num() == 0) return;
+
+	// Fill the voxels of every chunk on every core. A Blueprint voxel distribution without a column generator forces the game thread.
+	// Pooled actors can be of another class or have another generator, so every chunk of the batch is checked.
+	{
+		SCOPE_CYCLE_COUNTER(STAT_VoxelFillVoxels);
+		bool bSingleThread = CVarVoxelParallelGeneration.GetValueOnGameThread() == 0;
+		for (int i = 0; i < newChunks.Num() && !bSingleThread; i++) {
+			bSingleThread = !newChunks[i]->CanFillVoxelsInParallel();
+		}
+		ParallelFor(newChunks.Num(), [&](int32 i) {
+			newChunks[i]->FillVoxels(noise[i]);
+		}, bSingleThread);
+	}
+
+	// Every chunk of the batch is generated before the first mesh is requested, so the faces between them are culled right away.
+	// The meshes are built in the background and uploaded during the next frames.
+	for (AChunkActor* chunk : newChunks) {
+		chunk->bGenerated = true;
+	}
+	for (AChunkActor* chunk : newChunks) {
+		chunk->FinishGeneration(&generatedTogether);
+	}
 }
 
 void AChunkManager::SpawnChunk(const FVector2D& position, const FChunkInformation& information)
@@ -169,17 +335,220 @@ void AChunkManager::SpawnChunk(const FVector2D& position, const FChunkInformatio
 	chunkIndexY = (sign * chunkIndexY) % 16;
 
 
-	AChunkActor* chunk = GetWorld()->SpawnActorDeferred<AChunkActor>(
+	// Loaded chunks replace the streamed ones.
+	FIntPoint coordinates(FMath::RoundToInt(position.X), FMath::RoundToInt(position.Y));
+	RemoveChunk(coordinates);
+	worldStore.Remove(coordinates);
+
+	AChunkActor* chunk = AcquireChunk(FTransform(FVector((chunkIndexX + 16 * assignedRegion.X) * voxelSize * chunkWidth, (chunkIndexY + 16 * assignedRegion.Y) * voxelSize * chunkWidth, 0)));
+	chunk->Initialize(AssetList, voxelSize, chunkWidth, chunkHight, FVector2D(position.X, position.Y), 16);
+	chunk->SetChunkData(worldStore.FindOrAdd(coordinates));
+	chunks.Add(coordinates, chunk);
+	spawnedChunks.Add(chunk);
+	if (!chunk->IsActorInitialized())
+		chunk->FinishSpawning(FTransform(FVector((chunkIndexX + 16 * assignedRegion.X) * voxelSize * chunkWidth, (chunkIndexY + 16 * assignedRegion.Y) * voxelSize * chunkWidth, 0)), true, nullptr);
+	UpdateChunkDetail(chunk);
+	chunk->GenerateChunk(information.containedVoxel);
+}
+
+bool AChunkManager::UpdatePlayerChunks() {
+
+	TArray<FIntPoint> currentPlayerChunks;
+	playerViewDirections.Reset();
+	for (FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		APlayerController* controller = iterator->Get();
+		if (!controller || !controller->GetPawn()) continue;
+
+		FVector chunkPosition = controller->GetPawn()->GetActorLocation() / (voxelSize * chunkWidth);
+		currentPlayerChunks.Add(FIntPoint(FMath::RoundToInt(chunkPosition.X), FMath::RoundToInt(chunkPosition.Y)));
+
+		FVector viewDirection = controller->GetControlRotation().Vector();
+		playerViewDirections.Add(FVector2D(viewDirection.X, viewDirection.Y).GetSafeNormal());
+	}
+
+	if (currentPlayerChunks == playerChunks) return false;
+	playerChunks = currentPlayerChunks;
+
+	// Keep the chunks around the first player inside the lookup windows.
+	if (playerChunks.Num() > 0) {
+		chunks.SetOrigin(playerChunks[0]);
+		worldStore.SetOrigin(playerChunks[0]);
+	}
+	return true;
+}
+
+int AChunkManager::GetPlayerDistance(const FIntPoint& coordinates) const {
+	return GetChunkDistance(playerChunks, coordinates);
+}
+
+void AChunkManager::UpdateStreaming() {
+
+	// Stream around the world origin, until the first player arrives.
+	TArray<FIntPoint> centres = playerChunks;
+	TArray<FVector2D> viewDirections = playerViewDirections;
+	if (centres.Num() == 0) {
+		centres.Add(FIntPoint(0, 0));
+		viewDirections.Add(FVector2D::ZeroVector);
+	}
+
+	// Remove the spawned chunks beyond the unload radius.
+	int removeDistance = FMath::Max(unloadRadius, viewRadius + 1);
+	TArray<FIntPoint> distantChunks;
+	chunks.ForEach([&](const FIntPoint& coordinates, AChunkActor* chunk) {
+		if (GetChunkDistance(centres, coordinates) >= removeDistance)
+			distantChunks.Add(coordinates);
+	});
+	for (const FIntPoint& coordinates : distantChunks) {
+		RemoveChunk(coordinates);
+	}
+
+	// Unload the voxels of distant unmodified chunks, they are generated again when needed.
+	// Modified chunks are saved instead, because they can't be generated again.
+	int unloadDistance = FMath::Max(storeRadius, removeDistance);
+	bool bSaveModifiedChunks = false;
+	TArray<FIntPoint> distantData;
+	worldStore.ForEachChunk([&](const FIntPoint& coordinates, const FVoxelChunkDataPtr& data) {
+		if (GetChunkDistance(centres, coordinates) < unloadDistance || chunks.Find(coordinates)) return;
+
+		if (!data->bModified)
+			distantData.Add(coordinates);
+		else if (data->markedForSaving)
+			bSaveModifiedChunks = true;
+	});
+	for (const FIntPoint& coordinates : distantData) {
+		worldStore.Remove(coordinates);
+	}
+	if (bSaveModifiedChunks)
+		SaveWorld();
+
+	// Queue the missing chunks inside the view radius.
+	TSet<FIntPoint> missingChunks;
+	for (const FIntPoint& centre : centres) {
+		for (int x = -viewRadius; x <= viewRadius; x++) {
+		for (int y = -viewRadius; y <= viewRadius; y++) {
+			FIntPoint coordinates = centre + FIntPoint(x, y);
+			if (!chunks.Find(coordinates))
+				missingChunks.Add(coordinates);
+		}
+		}
+	}
+
+	// Close chunks and chunks in front of a player are spawned first.
+	TArray<TPair<float, FIntPoint>> prioritisedChunks;
+	prioritisedChunks.Reserve(missingChunks.Num());
+	for (const FIntPoint& coordinates : missingChunks) {
+		float priority = MAX_flt;
+		for (int p = 0; p < centres.Num(); p++) {
+			FVector2D offset = FVector2D(coordinates - centres[p]);
+			float alignment = FVector2D::DotProduct(offset.GetSafeNormal(), viewDirections[p]);
+			priority = FMath::Min(priority, offset.Size() * (1.0f - viewDirectionWeight * alignment));
+		}
+		prioritisedChunks.Emplace(priority, coordinates);
+	}
+	prioritisedChunks.Sort([](const TPair<float, FIntPoint>& a, const TPair<float, FIntPoint>& b) {
+		return a.Key > b.Key;
+	});
+
+	chunkLoadQueue.Reset(prioritisedChunks.Num());
+	for (const TPair<float, FIntPoint>& chunk : prioritisedChunks) {
+		chunkLoadQueue.Add(chunk.Value);
+	}
+}
+
+void AChunkManager::ProcessChunkLoadQueue() {
+
+	if (!IsValid(chunkClass)) return;
+
+	// Spawn the most important chunks in batches of one chunk per core, until the frame budget is used up.
+	// At least one batch is spawned per frame, so the queue can't stall.
+	const int batchSize = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	double startTime = FPlatformTime::Seconds();
+	TArray<FIntPoint> batch;
+	while (chunkLoadQueue.Num() > 0) {
+		batch.Reset();
+		while (batch.Num() < batchSize && chunkLoadQueue.Num() > 0) {
+			FIntPoint coordinates = chunkLoadQueue.Pop(false);
+			if (!chunks.Find(coordinates))
+				batch.Add(coordinates);
+		}
+		SpawnChunks(batch);
+
+		if ((FPlatformTime::Seconds() - startTime) * 1000.0 >= streamingBudget)
+			break;
+	}
+}
+
+AChunkActor* AChunkManager::AcquireChunk(const FTransform& transform) {
+
+	// Recycled chunks keep their procedural mesh component, so nothing has to be spawned or registered.
+	while (chunkPool.Num() > 0) {
+		AChunkActor* chunk = chunkPool.Pop(false);
+		if (!IsValid(chunk)) continue;
+
+		// Chunks of a previous chunk class can't be reused.
+		if (chunk->GetClass() != chunkClass) {
+			chunk->Destroy();
+			continue;
+		}
+
+		chunk->SetActorTransform(transform);
+		INC_DWORD_STAT(STAT_VoxelChunksRecycled);
+		return chunk;
+	}
+
+	INC_DWORD_STAT(STAT_VoxelChunksSpawned);
+	return GetWorld()->SpawnActorDeferred<AChunkActor>(
 		chunkClass,
-		FTransform(FVector((chunkIndexX + 16 * assignedRegion.X) * voxelSize * chunkWidth, (chunkIndexY + 16 * assignedRegion.Y) * voxelSize * chunkWidth, 0)),
+		transform,
 		this,
 		nullptr,
 		ESpawnActorCollisionHandlingMethod::AlwaysSpawn
 		);
-	chunk->Initialize(AssetList, voxelSize, chunkWidth, chunkHight, FVector2D(position.X, position.Y), 16);
-	chunks.Add(FVector2D(position.X, position.Y), chunk);
-	chunk->FinishSpawning(FTransform(FVector((chunkIndexX + 16 * assignedRegion.X) * voxelSize * chunkWidth, (chunkIndexY + 16 * assignedRegion.Y) * voxelSize * chunkWidth, 0)), true, nullptr);
-	chunk->GenerateChunk(information.containedVoxel);
+}
+
+bool AChunkManager::RemoveChunk(const FIntPoint& coordinates) {
+
+	AChunkActor* chunk = chunks.FindRef(coordinates);
+	if (!chunk) return false;
+
+	chunks.Remove(coordinates);
+	spawnedChunks.RemoveSingleSwap(chunk);
+
+	// Keep the chunk for recycling, as long as the pool has room.
+	if (chunkPool.Num() < maxPoolSize) {
+		chunk->ReleaseChunk();
+		chunkPool.Add(chunk);
+	}
+	else {
+		chunk->Destroy();
+	}
+
+	// Let the neighbours show their faces towards the removed chunk.
+	const FIntPoint offsets[] = { FIntPoint(0, 1), FIntPoint(0, -1), FIntPoint(1, 0), FIntPoint(-1, 0) };
+	for (int face = 2; face < 6; face++) {
+		AChunkActor* neighbour = chunks.FindRef(coordinates + offsets[face - 2]);
+		if (!neighbour || !neighbour->bGenerated) continue;
+
+		neighbour->MarkBorderDirty(face ^ 1);
+		neighbour->RequestMeshUpdate();
+	}
+	return true;
+}
+
+int AChunkManager::GetLODLevel(int distance) const {
+
+	int level = 0;
+	while (level < lodDistances.Num() && distance >= lodDistances[level])
+		level++;
+	return level;
+}
+
+void AChunkManager::UpdateChunkDetail(AChunkActor* chunk) const {
+
+	if (playerChunks.Num() == 0) return;
+	int distance = GetPlayerDistance(chunk->chunkCoordinates);
+	chunk->SetLODLevel(GetLODLevel(distance));
+	chunk->SetChunkCollision(distance <= collisionRadius);
 }
 
 void AChunkManager::SaveWorld() {
@@ -189,13 +558,42 @@ void AChunkManager::SaveWorld() {
 	information.chunkHeight = chunkHight;
 	information.chunkWidth = chunkWidth;
 	information.regionWidth = 16;
-	TSet<AChunkActor*> chunkActor;
 
-	for (const TPair<FVector2D, AChunkActor*>& pair : chunks) {
-		chunkActor.Add(pair.Value);
+	// Only one save can run at a time.
+	if (!FSaveManager::IsThreadFinished()) return;
+
+	// Shut down a finished save, which the timer hasn't released yet. Otherwise no new save would be started.
+	if (FSaveManager::HasThread()) {
+		GetWorldTimerManager().ClearTimer(SaveThreadTimerHandle);
+		SaveWorldCallback(true);
 	}
 
-	FSaveManager::JoyInit(information, chunkActor, this);
+	// Capture the changed chunks of the world store, whether they are spawned or not.
+	// The snapshots share the voxel sections with the chunks, so this doesn't copy any voxels.
+	// Edits during the save copy the touched section and mark the chunk for the next save again.
+	TArray<FChunkSaveSnapshot> chunkSnapshots;
+	TArray<FVoxelChunkDataPtr> savedChunks;
+	worldStore.ForEachChunk([&](const FIntPoint& coordinates, const FVoxelChunkDataPtr& data) {
+		FVoxelChunkData& chunk = *data;
+		if (!chunk.bGenerated || !chunk.markedForSaving) return;
+
+		FChunkSaveSnapshot& snapshot = chunkSnapshots.AddDefaulted_GetRef();
+		snapshot.assignedRegion = chunk.assignedRegion;
+		snapshot.chunkIndexX = chunk.regionIndexX;
+		snapshot.chunkIndexY = chunk.regionIndexY;
+		snapshot.chunkWidth = chunkWidth;
+		snapshot.chunkHeight = chunkHight;
+		snapshot.voxelAssetIDs = chunk.voxelAssetIDs;
+		savedChunks.Add(data);
+	});
+
+	// Keep the chunks marked, if no save thread could be started.
+	if (!FSaveManager::JoyInit(information, MoveTemp(chunkSnapshots), this)) return;
+
+	for (const FVoxelChunkDataPtr& data : savedChunks) {
+		data->markedForSaving = false;
+		data->voxelAssetChanged.Reset();
+	}
 	GetWorldTimerManager().SetTimer(SaveThreadTimerHandle, this, &AChunkManager::CheckWorldSaveDone, 1, true);
 
 	
@@ -211,12 +609,7 @@ void AChunkManager::CheckWorldSaveDone()
 
 void AChunkManager::SaveWorldCallback(bool succeeded) {
 
-	for (const TPair<FVector2D, AChunkActor*>& pair : chunks) {
-		pair.Value->markedForSaving = false;
-		pair.Value->voxelAssetChanged = TSet<int>();
-	}
-
-
+	// The chunks were already unmarked, when their snapshots were handed to the save thread.
 	FSaveManager::Shutdown();
 
 }
@@ -225,6 +618,7 @@ void AChunkManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	FLoadManager::Shutdown();
 	FSaveManager::Shutdown();
+	worldStore.Empty();
 	Super::EndPlay(EndPlayReason);
 }
 
@@ -245,10 +639,32 @@ void AChunkManager::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
-	FVector2D Ref;
-	
-	
+	// Update the level of detail and collision, whenever a player enters another chunk.
+	if (UpdatePlayerChunks()) {
+		chunks.ForEach([&](const FIntPoint& coordinates, AChunkActor* chunk) {
+			if (chunk)
+				UpdateChunkDetail(chunk);
+		});
+
+		if (bStreamChunks)
+			UpdateStreaming();
+	}
+
+	// Spawn the queued chunks around the players.
+	if (bStreamChunks)
+		ProcessChunkLoadQueue();
 
+	// Upload meshes that finished in the background until the frame budget is used up.
+	// At least one mesh is uploaded per frame, so the queue can't stall.
+	double startTime = FPlatformTime::Seconds();
+	FChunkMeshResultPtr result;
+	while (meshResultQueue->Dequeue(result)) {
+		if (AChunkActor* chunk = result->chunk.Get())
+			chunk->ApplyMeshUpdate(*result);
+
+		if ((FPlatformTime::Seconds() - startTime) * 1000.0 >= meshUploadBudget)
+			break;
+	}
 }
 
 
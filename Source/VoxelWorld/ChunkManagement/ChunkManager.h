@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "ChunkActor.h"
+#include "ChunkGrid.h"
+#include "../Assets/VoxelGeneratorAsset.h"
 #include "Runtime/Engine/Classes/Kismet/GameplayStatics.h"
 #include "../SaveGames/SaveManager.h"
 #include "../SaveGames/LoadManager.h"
@@ -49,9 +51,22 @@ protected:
 	UPROPERTY(editanywhere, BlueprintReadOnly, category = "settings|Default")
 		TSubclassOf<AChunkActor> chunkClass;
 
-	// A map of all chunks combined with their position as keys.
+	// The native terrain generator. Without one the chunks use their noise and voxel distribution events.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Settings|Default")
+		UVoxelGeneratorAsset* generatorAsset = nullptr;
+
+	// The generator created from the generator asset at the beginning of play.
+	FVoxelColumnGeneratorPtr columnGenerator;
+
+	// Every spawned chunk. Keeps the chunks referenced for the garbage collector.
 	UPROPERTY()
-		TMap<FVector2D, AChunkActor*> chunks;
+		TArray<AChunkActor*> spawnedChunks;
+
+	// The spawned chunks combined with their X and Y index.
+	TChunkGrid<AChunkActor*> chunks;
+
+	// The voxels of every loaded chunk. The spawned chunks only render a part of them.
+	FVoxelWorldStore worldStore;
 
 	FTimerHandle LoadThreadTimerHandle;
 
@@ -61,6 +76,80 @@ protected:
 
 	TArray<FChunkInformation> chunksList;
 
+/// ------ Performance ------ \\\
+
+protected:
+	// The time in milliseconds per frame that may be spent uploading finished chunk meshes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Performance", Meta = (UIMin = 0.1, UIMax = 16, ClampMin = 0.1))
+		float meshUploadBudget = 2.0f;
+
+	// The queue of chunk meshes that were built in the background and wait for their upload.
+	TSharedPtr<FChunkMeshResultQueue, ESPMode::ThreadSafe> meshResultQueue;
+
+	// The distances in chunks from the player, from which on the next level of detail is used.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Performance")
+		TArray<int> lodDistances = { 4, 8, 16 };
+
+	// The distance in chunks from the nearest player, up to which chunks build collision.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Performance", Meta = (ClampMin = 0))
+		int collisionRadius = 2;
+
+	// The chunks the players were inside during the last detail update.
+	TArray<FIntPoint> playerChunks;
+
+	// The distance in chunks from the first player, up to which chunks are found without hashing. Chunks further away are found through a map.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Settings|Performance", Meta = (ClampMin = 0, ClampMax = 256))
+		int gridRadius = 24;
+
+/// ------ Streaming ------ \\\
+
+protected:
+	// Should chunks be spawned and removed around the players instead of generating a fixed area once.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming")
+		bool bStreamChunks = true;
+
+	// The distance in chunks from the players, up to which chunks are spawned.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (ClampMin = 0, ClampMax = 128))
+		int viewRadius = 8;
+
+	// The distance in chunks from the players, from which on spawned chunks are removed again.
+	// Keep it above the view radius, so chunks on the border don't flicker, while a player moves back and forth.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (ClampMin = 1, ClampMax = 128))
+		int unloadRadius = 10;
+
+	// The distance in chunks from the players, from which on the voxels of unmodified chunks are unloaded from the world store.
+	// Modified chunks are saved and stay loaded, because they can't be generated again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (ClampMin = 1))
+		int storeRadius = 32;
+
+	// How much closer chunks in front of a player appear to the load queue. Zero ignores the view direction.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (ClampMin = 0, ClampMax = 0.9))
+		float viewDirectionWeight = 0.5f;
+
+	// The time in milliseconds per frame that may be spent spawning queued chunks.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (UIMin = 0.1, UIMax = 16, ClampMin = 0.1))
+		float streamingBudget = 2.0f;
+
+	// The maximum number of removed chunks kept for recycling. Further removed chunks are destroyed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings|Streaming", Meta = (ClampMin = 0))
+		int maxPoolSize = 64;
+
+	// The removed chunks waiting to be recycled. They are hidden and have no mesh.
+	UPROPERTY()
+		TArray<AChunkActor*> chunkPool;
+
+	// The chunks waiting to be spawned. The most important chunk is at the end.
+	TArray<FIntPoint> chunkLoadQueue;
+
+	// The direction every player looks at, in the same order as the player chunks.
+	TArray<FVector2D> playerViewDirections;
+
+public:
+	// Receive the queue background mesh builds hand their results to.
+	TSharedPtr<FChunkMeshResultQueue, ESPMode::ThreadSafe> GetMeshResultQueue() const {
+		return meshResultQueue;
+	}
+
 
 /// ------ FUNCTIONS ------ \\\
 /// ------ Initialization ------ \\\
@@ -95,11 +184,98 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Update")
 		void SetVoxel(FVector position, int value);
 
+	// Replace a voxel at the given world voxel position. Works across chunk borders and for loaded chunks, which aren't spawned.
+	// @param voxel - The X, Y and Z position of the voxel in the world.
+	// @param value - The ID of the new voxel type.
+	// @return - Did the replacement succeed?
+	bool SetVoxel(const FIntVector& voxel, int value);
+
+	// Receive the asset ID of the voxel at the given location. Works for every loaded chunk, whether it's spawned or not.
+	// @param position - A location inside the voxel in unreal units.
+	// @return - The voxel asset ID or -1, if the voxel isn't loaded.
+	UFUNCTION(BlueprintCallable, Category = "Voxel", Meta = (Keywords = "Get, Voxel, Query, Asset, ID, World"))
+		int GetVoxel(FVector position) const;
+
+	// Receive the asset ID of the voxel at the given world voxel position.
+	// @param voxel - The X, Y and Z position of the voxel in the world.
+	// @return - The voxel asset ID or -1, if the voxel isn't loaded.
+	int GetVoxel(const FIntVector& voxel) const;
+
+	// Calculate the world voxel position of the voxel containing the given location.
+	// @param position - A location inside the voxel in unreal units.
+	// @return - The X, Y and Z position of the voxel in the world.
+	UFUNCTION(BlueprintPure, Category = "Voxel", Meta = (Keywords = "Get, Voxel, Position, Coordinates, World"))
+		FIntVector GetVoxelCoordinates(FVector position) const;
+
+	// Split a world voxel position into the chunk and the position inside the chunk.
+	// @param voxel - The X, Y and Z position of the voxel in the world.
+	// @param localVoxel - The X, Y and Z position of the voxel inside the chunk.
+	// @return - The X and Y index of the chunk.
+	FIntPoint GetChunkCoordinates(const FIntVector& voxel, FIntVector& localVoxel) const;
+
+	// Find the chunk at the given chunk coordinates.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The chunk or nullptr, if none is spawned there.
+	AChunkActor* GetChunk(const FIntPoint& coordinates) const;
+
+	// Receive the voxels of every loaded chunk.
+	FVoxelWorldStore& GetWorldStore() {
+		return worldStore;
+	}
+
 	UFUNCTION(BlueprintCallable, Category = "Update")
 	void SpawnChunk(const FVector2D& position);
 
 	void SpawnChunk(const FVector2D& position, const FChunkInformation& information);
 
+	// Spawn and generate several chunks at once. The voxels of all chunks are filled in parallel.
+	// @param coordinatesList - The X and Y index of every chunk. Spawned chunks are skipped.
+	// @return - VOID
+	void SpawnChunks(const TArray<FIntPoint>& coordinatesList);
+
+	// Spawn or recycle a chunk and give it its voxels from the world store. The chunk still has to be generated.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The chunk.
+	AChunkActor* PrepareChunk(const FIntPoint& coordinates);
+
+	// Find the chunks every player is inside.
+	// @return - Did any player enter another chunk?
+	bool UpdatePlayerChunks();
+
+	// Queue the missing chunks around the players, remove the distant chunks and unload the distant voxels.
+	// Without players the chunks around the world origin are streamed.
+	// @return - VOID
+	void UpdateStreaming();
+
+	// Spawn queued chunks until the frame budget is used up.
+	// @return - VOID
+	void ProcessChunkLoadQueue();
+
+	// Recycle a removed chunk or spawn a new one. Spawned chunks still have to finish spawning.
+	// @param transform - The transform of the chunk.
+	// @return - The chunk.
+	AChunkActor* AcquireChunk(const FTransform& transform);
+
+	// Remove a spawned chunk. It is kept for recycling and its voxels stay inside the world store.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - Was a chunk spawned there?
+	bool RemoveChunk(const FIntPoint& coordinates);
+
+	// Calculate the distance of the chunk at the given coordinates to the nearest player.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The distance in chunks.
+	int GetPlayerDistance(const FIntPoint& coordinates) const;
+
+	// Calculate the level of detail for a chunk at the given distance.
+	// @param distance - The distance in chunks to the nearest player.
+	// @return - The level of detail.
+	int GetLODLevel(int distance) const;
+
+	// Update the level of detail and collision of a chunk based on its distance to the players. Nothing changes without players.
+	// @param chunk - The chunk to update.
+	// @return - VOID
+	void UpdateChunkDetail(AChunkActor* chunk) const;
+
 	UFUNCTION(BlueprintCallable, Category = "Update")
 		void SaveWorld();
 
@@ -119,7 +295,5 @@ protected:
 	UFUNCTION(BlueprintCallable, Category = "Debug", Meta = (Keywords = "Debug, Print, Log, Warning, Screen, OutputLog"))
 		void PrintDebugWarning(TArray<FString> information);
 
-	TQueue<FVector2D> ChunksQueue;
-
 	virtual void Tick(float DeltaSeconds) override;
 };
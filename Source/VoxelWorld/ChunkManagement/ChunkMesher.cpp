@@ -0,0 +1,810 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkMesher.h"
+#include "HAL/IConsoleManager.h"
+
+#pragma region Voxel Values
+const int bTriangles[] = { 2,1,0,0,3,2 };
+const FVector2D bUVs[] = { FVector2D(0,0), FVector2D(0,1), FVector2D(1,1), FVector2D(1,0) };
+const FVector bNormals0[] = { FVector(0,0,1), FVector(0,0,1), FVector(0,0,1), FVector(0,0,1) };
+const FVector bNormals1[] = { FVector(0,0,-1), FVector(0,0,-1), FVector(0,0,-1), FVector(0,0,-1) };
+const FVector bNormals2[] = { FVector(0,1,0), FVector(0,1,0), FVector(0,1,0), FVector(0,1,0) };
+const FVector bNormals3[] = { FVector(0,-1,0), FVector(0,-1,0), FVector(0,-1,0), FVector(0,-1,0) };
+const FVector bNormals4[] = { FVector(1,0,0), FVector(1,0,0), FVector(1,0,0), FVector(1,0,0) };
+const FVector bNormals5[] = { FVector(-1,0,0), FVector(-1,0,0), FVector(-1,0,0), FVector(-1,0,0) };
+const FVector* bNormals[] = { bNormals0, bNormals1, bNormals2, bNormals3, bNormals4, bNormals5 };
+const int bMask[][3] = { {0,0,1}, {0,0,-1}, {0,1,0}, {0,-1,0}, {1,0,0}, {-1,0,0} };
+
+// Selects the lower (0) or upper (1) bound per axis for the four corners of every face.
+const int bCorners[6][4][3] = {
+	{ {1,0,1}, {1,1,1}, {0,1,1}, {0,0,1} },
+	{ {0,0,0}, {0,1,0}, {1,1,0}, {1,0,0} },
+	{ {1,1,1}, {1,1,0}, {0,1,0}, {0,1,1} },
+	{ {0,0,1}, {0,0,0}, {1,0,0}, {1,0,1} },
+	{ {1,0,1}, {1,0,0}, {1,1,0}, {1,1,1} },
+	{ {0,1,1}, {0,1,0}, {0,0,0}, {0,0,1} }
+};
+#pragma endregion
+
+DECLARE_CYCLE_STAT(TEXT("Build Chunk Mesh"), STAT_VoxelBuildChunkMesh, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunk Mesh Builds"), STAT_VoxelChunkMeshBuilds, STATGROUP_VoxelWorld);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunk Mesh Build Allocations"), STAT_VoxelChunkMeshAllocations, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Face Culling (Bitmask)"), STAT_VoxelFaceCullingBitmask, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Face Culling (Per Voxel)"), STAT_VoxelFaceCullingPerVoxel, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Face Culling (Static Dims)"), STAT_VoxelFaceCullingStaticDims, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Face Culling (Dynamic Dims)"), STAT_VoxelFaceCullingDynamicDims, STATGROUP_VoxelWorld);
+
+static TAutoConsoleVariable<int32> CVarVoxelBinaryFaceCulling(
+	TEXT("voxel.BinaryFaceCulling"),
+	1,
+	TEXT("Cull chunk faces with column bitmasks (1) or with the per voxel neighbour checks (0). Compare both with \"stat VoxelWorld\"."),
+	ECVF_Default);
+
+
+/// ------ Scratch ------ \\\
+
+FChunkMeshScratch& FChunkMeshScratch::Get() {
+	static thread_local FChunkMeshScratch scratch;
+	return scratch;
+}
+
+int FChunkMeshScratch::Prepare(int numOfAssets, const int* vertexCountHints) {
+
+	if (voxelMeshInformation.Num() < numOfAssets)
+		voxelMeshInformation.SetNum(numOfAssets);
+
+	// Keep the memory of the previous section and grow it to the expected size.
+	for (int i = 0; i < numOfAssets; i++) {
+		FVoxelMeshInformation& meshInformation = voxelMeshInformation[i];
+		meshInformation.Vertices.Reset();
+		meshInformation.Triangles.Reset();
+		meshInformation.Normals.Reset();
+		meshInformation.UVs.Reset();
+		meshInformation.VertexColors.Reset();
+		meshInformation.Tangents.Reset();
+		meshInformation.elementID = 0;
+
+		int hint = vertexCountHints ? vertexCountHints[i] : 0;
+		if (hint <= 0) continue;
+		meshInformation.Vertices.Reserve(hint);
+		meshInformation.Triangles.Reserve(hint / 4 * 6);
+		meshInformation.Normals.Reserve(hint);
+		meshInformation.UVs.Reserve(hint);
+		meshInformation.VertexColors.Reserve(hint);
+	}
+	return CountGrownBuffers();
+}
+
+int FChunkMeshScratch::CountGrownBuffers() {
+
+	// Every buffer whose capacity changed has allocated at least once.
+	int numOfGrown = 0;
+	int numOfMeshBuffers = voxelMeshInformation.Num() * 5;
+	int numOfBuffers = numOfMeshBuffers + 9;
+	if (capacities.Num() != numOfBuffers)
+		capacities.SetNumZeroed(numOfBuffers);
+
+	auto Check = [&](int buffer, int capacity) {
+		if (capacities[buffer] != capacity) {
+			capacities[buffer] = capacity;
+			numOfGrown++;
+		}
+	};
+
+	for (int i = 0; i < voxelMeshInformation.Num(); i++) {
+		const FVoxelMeshInformation& meshInformation = voxelMeshInformation[i];
+		Check(i * 5 + 0, meshInformation.Vertices.Max());
+		Check(i * 5 + 1, meshInformation.Triangles.Max());
+		Check(i * 5 + 2, meshInformation.Normals.Max());
+		Check(i * 5 + 3, meshInformation.UVs.Max());
+		Check(i * 5 + 4, meshInformation.VertexColors.Max());
+	}
+	Check(numOfMeshBuffers, mask.Max());
+	Check(numOfMeshBuffers + 1, occupancy.Max());
+	Check(numOfMeshBuffers + 2, solid.Max());
+	for (int i = 0; i < 6; i++) {
+		Check(numOfMeshBuffers + 3 + i, faceMasks[i].Max());
+	}
+	return numOfGrown;
+}
+
+
+/// ------ Mesher ------ \\\
+
+void FChunkMesher::BuildMesh(const FChunkMeshSnapshot& snapshot, FChunkMeshResult& result) {
+
+	SCOPE_CYCLE_COUNTER(STAT_VoxelBuildChunkMesh);
+
+	FChunkMeshScratch& scratch = FChunkMeshScratch::Get();
+	int numOfAssets = snapshot.validAssetIDs.Num();
+
+	result.numOfInvalidVoxels = 0;
+	result.numOfAllocations = 0;
+	result.sections.SetNum(snapshot.dirtySections.Num());
+
+	// Distant chunks are meshed from a coarser grid. The borders of coarser neighbours are resolved into the cells they show.
+	bool bCoarseNeighbours = false;
+	for (int i = 0; i < 4; i++) {
+		bCoarseNeighbours |= snapshot.neighbourCellSizes[i] > 1;
+	}
+
+	int cellSize = 1;
+	const FChunkMeshSnapshot* grid = &snapshot;
+	if (snapshot.lodLevel > 0 || bCoarseNeighbours) {
+		cellSize = DownsampleSnapshot(snapshot, scratch);
+		grid = &scratch.lodSnapshot;
+	}
+
+	// Find every visible face of the chunk at once.
+	CullFaces(*grid, CVarVoxelBinaryFaceCulling.GetValueOnAnyThread() != 0, scratch, result);
+
+	for (int s = 0; s < snapshot.dirtySections.Num(); s++) {
+		FChunkSectionMesh& section = result.sections[s];
+		section.sectionIndex = snapshot.dirtySections[s];
+		section.bHasCollision = snapshot.bBuildCollision;
+
+		// The height range of the grid covered by this section.
+		int zMin = FMath::DivideAndRoundUp(section.sectionIndex * snapshot.sectionHeight, cellSize);
+		int zMax = FMath::Min(FMath::DivideAndRoundUp((section.sectionIndex + 1) * snapshot.sectionHeight, cellSize), grid->chunkHeight);
+
+		// Leave the section empty, if it can't contain a visible face.
+		if (!HasVisibleFaces(*grid, scratch, zMin, zMax)) continue;
+
+		// Reuse the buffers of this thread, reserved for the size of the previous build.
+		int hintOffset = section.sectionIndex * numOfAssets;
+		const int* hints = snapshot.vertexCountHints.IsValidIndex(hintOffset + numOfAssets - 1) ? &snapshot.vertexCountHints[hintOffset] : nullptr;
+		result.numOfAllocations += scratch.Prepare(numOfAssets, hints);
+
+		// Merge coplanar faces of the same asset, if selected.
+		if (snapshot.bGreedyMeshing)
+			BuildGreedyFaces(*grid, zMin, zMax, scratch, result);
+		else {
+			DispatchChunkDims(grid->chunkWidth, grid->chunkHeight, [&](const auto& dims) {
+				BuildNaiveFaces(dims, *grid, zMin, zMax, scratch, result);
+			});
+		}
+		BuildSkirts(*grid, zMin, zMax, scratch);
+
+		result.numOfAllocations += scratch.CountGrownBuffers();
+		result.numOfAllocations += CopyToSection(scratch, numOfAssets, section);
+
+		// The collision is built only for chunks close to a player.
+		if (snapshot.bBuildCollision) {
+			BuildCollision(*grid, zMin, zMax, scratch, result);
+
+			const FVoxelMeshInformation& collision = scratch.collisionMeshInformation;
+			section.collisionMeshInformation.Vertices = collision.Vertices;
+			section.collisionMeshInformation.Triangles = collision.Triangles;
+			section.collisionMeshInformation.hash = FCrc::MemCrc32(collision.Vertices.GetData(), collision.Vertices.Num() * sizeof(FVector));
+			result.numOfAllocations += 2;
+		}
+	}
+
+	INC_DWORD_STAT(STAT_VoxelChunkMeshBuilds);
+	INC_DWORD_STAT_BY(STAT_VoxelChunkMeshAllocations, result.numOfAllocations);
+}
+
+int FChunkMesher::CopyToSection(const FChunkMeshScratch& scratch, int numOfAssets, FChunkSectionMesh& section) {
+
+	int numOfAllocations = 0;
+	section.voxelMeshInformation.SetNum(numOfAssets);
+	numOfAllocations++;
+
+	// Only assets with faces need memory.
+	for (int i = 0; i < numOfAssets; i++) {
+		const FVoxelMeshInformation& source = scratch.voxelMeshInformation[i];
+		if (source.Vertices.Num() == 0) continue;
+
+		FVoxelMeshInformation& target = section.voxelMeshInformation[i];
+		target.Vertices = source.Vertices;
+		target.Triangles = source.Triangles;
+		target.Normals = source.Normals;
+		target.UVs = source.UVs;
+		target.VertexColors = source.VertexColors;
+		target.elementID = source.elementID;
+		numOfAllocations += 5;
+
+		// The triangles follow from the vertex count, so the vertex data is enough to detect changes.
+		uint32 hash = FCrc::MemCrc32(target.Vertices.GetData(), target.Vertices.Num() * sizeof(FVector));
+		hash = FCrc::MemCrc32(target.Normals.GetData(), target.Normals.Num() * sizeof(FVector), hash);
+		hash = FCrc::MemCrc32(target.UVs.GetData(), target.UVs.Num() * sizeof(FVector2D), hash);
+		target.hash = FCrc::MemCrc32(target.VertexColors.GetData(), target.VertexColors.Num() * sizeof(FColor), hash);
+	}
+	return numOfAllocations;
+}
+
+int FChunkMesher::GetCellSize(int chunkWidth, int lodLevel) {
+
+	// The cells have to split the chunk width evenly.
+	while (lodLevel > 0 && chunkWidth % (1 << lodLevel) != 0)
+		lodLevel--;
+	return 1 << lodLevel;
+}
+
+int FChunkMesher::DownsampleSnapshot(const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch) {
+
+	FChunkMeshSnapshot& grid = scratch.lodSnapshot;
+	const int cellSize = GetCellSize(snapshot.chunkWidth, snapshot.lodLevel);
+
+	grid.validAssetIDs = snapshot.validAssetIDs;
+	grid.voxelSize = snapshot.voxelSize * cellSize;
+	grid.voxelSizeHalved = snapshot.voxelSizeHalved;
+	grid.chunkWidth = snapshot.chunkWidth / cellSize;
+	grid.chunkWidthSquared = grid.chunkWidth * grid.chunkWidth;
+	grid.chunkHeight = FMath::DivideAndRoundUp(snapshot.chunkHeight, cellSize);
+	grid.chunkOffset = snapshot.chunkOffset;
+	grid.sectionHeight = snapshot.sectionHeight;
+	grid.bGreedyMeshing = snapshot.bGreedyMeshing;
+	grid.lodLevel = 0;
+	grid.skirtDepth = snapshot.skirtDepth;
+	grid.bSimplifiedCollision = snapshot.bSimplifiedCollision;
+	ResolveNeighbourBorders(snapshot, cellSize, scratch);
+
+	// Full detail chunks keep their voxels and only need the resolved borders.
+	if (cellSize == 1) {
+		grid.voxelAssetIDs = snapshot.voxelAssetIDs;
+		grid.uniformSections = snapshot.uniformSections;
+		return cellSize;
+	}
+
+	grid.uniformSections.Reset();
+	grid.voxelAssetIDs.SetNumUninitialized(grid.chunkWidthSquared * grid.chunkHeight);
+	TArray<TPair<int, int>, TInlineAllocator<8>> candidates;
+
+	for (int cz = 0; cz < grid.chunkHeight; cz++) {
+	for (int cy = 0; cy < grid.chunkWidth; cy++) {
+	for (int cx = 0; cx < grid.chunkWidth; cx++) {
+
+		// Count the asset IDs inside the cell.
+		candidates.Reset();
+		int numOfVoxels = 0;
+		int numOfFilled = 0;
+		for (int z = cz * cellSize; z < FMath::Min((cz + 1) * cellSize, snapshot.chunkHeight); z++) {
+		for (int y = cy * cellSize; y < (cy + 1) * cellSize; y++) {
+		for (int x = cx * cellSize; x < (cx + 1) * cellSize; x++) {
+			numOfVoxels++;
+			int voxelAssetID = snapshot.voxelAssetIDs[x + y * snapshot.chunkWidth + z * snapshot.chunkWidthSquared];
+			if (voxelAssetID < 1) continue;
+
+			numOfFilled++;
+			TPair<int, int>* candidate = candidates.FindByPredicate([voxelAssetID](const TPair<int, int>& pair) { return pair.Key == voxelAssetID; });
+			if (candidate)
+				candidate->Value++;
+			else
+				candidates.Add(TPair<int, int>(voxelAssetID, 1));
+		}
+		}
+		}
+
+		// The majority of the filled voxels decides the asset of the cell.
+		int cellAssetID = 0;
+		if (numOfFilled * 2 >= numOfVoxels) {
+			int highestCount = 0;
+			for (const TPair<int, int>& candidate : candidates) {
+				if (candidate.Value > highestCount) {
+					highestCount = candidate.Value;
+					cellAssetID = candidate.Key;
+				}
+			}
+		}
+		grid.voxelAssetIDs[cx + cy * grid.chunkWidth + cz * grid.chunkWidthSquared] = cellAssetID;
+	}
+	}
+	}
+	return cellSize;
+}
+
+void FChunkMesher::ResolveNeighbourBorders(const FChunkMeshSnapshot& snapshot, int cellSize, FChunkMeshScratch& scratch) {
+
+	FChunkMeshSnapshot& grid = scratch.lodSnapshot;
+	TArray<bool>& neighbourCells = scratch.neighbourCells;
+	const int width = snapshot.chunkWidth;
+	const int height = snapshot.chunkHeight;
+
+	for (int side = 0; side < 4; side++) {
+		const TArray<int>& border = snapshot.neighbourBorders[side];
+		grid.neighbourBorders[side].Reset();
+		grid.neighbourCellSizes[side] = 1;
+		grid.skirtSides[side] = false;
+		if (border.Num() == 0) continue;
+
+		// Rebuild the cells along the border like the neighbour downsamples them, from as many layers as a cell is deep.
+		const int neighbourCellSize = snapshot.neighbourCellSizes[side];
+		const int numOfCellsU = width / neighbourCellSize;
+		const int numOfCellsZ = FMath::DivideAndRoundUp(height, neighbourCellSize);
+		neighbourCells.SetNumUninitialized(numOfCellsU * numOfCellsZ);
+
+		for (int cz = 0; cz < numOfCellsZ; cz++) {
+		for (int cu = 0; cu < numOfCellsU; cu++) {
+			int numOfVoxels = 0;
+			int numOfFilled = 0;
+			for (int layer = 0; layer < neighbourCellSize; layer++) {
+			for (int z = cz * neighbourCellSize; z < FMath::Min((cz + 1) * neighbourCellSize, height); z++) {
+			for (int u = cu * neighbourCellSize; u < (cu + 1) * neighbourCellSize; u++) {
+				numOfVoxels++;
+				if (border[u + z * width + layer * width * height] >= 1)
+					numOfFilled++;
+			}
+			}
+			}
+			neighbourCells[cu + cz * numOfCellsU] = numOfFilled * 2 >= numOfVoxels;
+		}
+		}
+
+		// Every cell of this chunk's ring covers one or more cells of the neighbour. It only hides faces, if all of them are filled.
+		TArray<int>& gridBorder = grid.neighbourBorders[side];
+		gridBorder.SetNumUninitialized(grid.chunkWidth * grid.chunkHeight);
+		for (int cz = 0; cz < grid.chunkHeight; cz++) {
+		for (int cu = 0; cu < grid.chunkWidth; cu++) {
+			bool bFilled = true;
+			for (int z = cz * cellSize / neighbourCellSize; z <= (FMath::Min((cz + 1) * cellSize, height) - 1) / neighbourCellSize && bFilled; z++) {
+			for (int u = cu * cellSize / neighbourCellSize; u <= ((cu + 1) * cellSize - 1) / neighbourCellSize && bFilled; u++) {
+				bFilled = neighbourCells[u + z * numOfCellsU];
+			}
+			}
+			gridBorder[cu + cz * grid.chunkWidth] = bFilled ? 1 : 0;
+		}
+		}
+
+		// The two cell sizes disagree about the exact surface along the seam, which can leave cracks between the faces.
+		grid.skirtSides[side] = neighbourCellSize != cellSize;
+	}
+}
+
+void FChunkMesher::BuildCollision(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result) {
+
+	FVoxelMeshInformation& collision = scratch.collisionMeshInformation;
+	collision.Vertices.Reset();
+	collision.Triangles.Reset();
+	collision.Normals.Reset();
+	collision.UVs.Reset();
+	collision.VertexColors.Reset();
+	collision.elementID = 0;
+
+	// Merge the faces regardless of their asset, which needs far fewer triangles to cook.
+	if (snapshot.bSimplifiedCollision) {
+		BuildGreedyFaces(snapshot, zMin, zMax, scratch, result, &collision);
+		return;
+	}
+
+	// Otherwise combine the render triangles of every asset.
+	for (int i = 0; i < snapshot.validAssetIDs.Num(); i++) {
+		const FVoxelMeshInformation& meshInformation = scratch.voxelMeshInformation[i];
+		for (int t : meshInformation.Triangles) {
+			collision.Triangles.Add(t + collision.Vertices.Num());
+		}
+		collision.Vertices.Append(meshInformation.Vertices);
+	}
+}
+
+template<typename TDims>
+void FChunkMesher::BuildFaceMasks(const TDims& dims, const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch, FChunkMeshResult& result) {
+
+	SCOPE_CYCLE_COUNTER(STAT_VoxelFaceCullingBitmask);
+
+	const TArray<int>& voxelAssetIDs = snapshot.voxelAssetIDs;
+	const int width = dims.GetWidth();
+	const int paddedWidth = width + 2;
+	const int numOfWords = dims.GetNumOfWords();
+	const int numOfColumns = width * width;
+
+	// One bit per voxel along every column. The occupancy has an additional ring of columns for the neighbour borders.
+	scratch.occupancy.SetNumUninitialized(paddedWidth * paddedWidth * numOfWords);
+	scratch.solid.SetNumUninitialized(numOfColumns * numOfWords);
+	FMemory::Memzero(scratch.occupancy.GetData(), scratch.occupancy.Num() * sizeof(uint64));
+	FMemory::Memzero(scratch.solid.GetData(), scratch.solid.Num() * sizeof(uint64));
+	uint64* occupancy = scratch.occupancy.GetData();
+	uint64* solid = scratch.solid.GetData();
+
+	// Pack the voxels of the chunk. Filled voxels hide faces, but only valid ones are meshed.
+	for (int zMin = 0; zMin < dims.GetHeight(); zMin += snapshot.sectionHeight) {
+		const int zMax = FMath::Min(zMin + snapshot.sectionHeight, dims.GetHeight());
+		const int section = zMin / snapshot.sectionHeight;
+
+		// Uniform sections fill whole column ranges at once.
+		if (snapshot.uniformSections.IsValidIndex(section) && snapshot.uniformSections[section]) {
+			int voxelAssetID = voxelAssetIDs[dims.GetIndex(0, 0, zMin)];
+			if (voxelAssetID < 1) continue;
+
+			bool bSolid = IsSolidVoxelID(snapshot, voxelAssetID);
+			if (!bSolid)
+				result.numOfInvalidVoxels += numOfColumns * (zMax - zMin);
+
+			for (int w = zMin >> 6; w <= (zMax - 1) >> 6; w++) {
+				uint64 sectionBits = GetSectionBits(w, zMin, zMax);
+				for (int y = 0; y < width; y++) {
+				for (int x = 0; x < width; x++) {
+					occupancy[((x + 1) + (y + 1) * paddedWidth) * numOfWords + w] |= sectionBits;
+					if (bSolid)
+						solid[dims.GetColumn(x, y) * numOfWords + w] |= sectionBits;
+				}
+				}
+			}
+			continue;
+		}
+
+		for (int z = zMin; z < zMax; z++) {
+			const int word = z >> 6;
+			const uint64 bit = 1ull << (z & 63);
+			const int* layer = &voxelAssetIDs[dims.GetIndex(0, 0, z)];
+
+			for (int y = 0; y < width; y++) {
+			for (int x = 0; x < width; x++) {
+				int voxelAssetID = layer[dims.GetColumn(x, y)];
+				if (voxelAssetID < 1) continue;
+
+				occupancy[((x + 1) + (y + 1) * paddedWidth) * numOfWords + word] |= bit;
+				if (IsSolidVoxelID(snapshot, voxelAssetID))
+					solid[dims.GetColumn(x, y) * numOfWords + word] |= bit;
+				else
+					result.numOfInvalidVoxels++;
+			}
+			}
+		}
+	}
+
+	// Pack the touching layers of the neighbours into the outer ring.
+	for (int face = 2; face < 6; face++) {
+		const TArray<int>& border = snapshot.neighbourBorders[face - 2];
+		if (border.Num() == 0) continue;
+
+		for (int z = 0; z < dims.GetHeight(); z++) {
+		for (int i = 0; i < width; i++) {
+			if (border[i + z * width] < 1) continue;
+
+			int column = 0;
+			switch (face) {
+			case 2: column = (i + 1) + (width + 1) * paddedWidth; break;
+			case 3: column = (i + 1); break;
+			case 4: column = (width + 1) + (i + 1) * paddedWidth; break;
+			default: column = (i + 1) * paddedWidth; break;
+			}
+			occupancy[column * numOfWords + (z >> 6)] |= 1ull << (z & 63);
+		}
+		}
+	}
+
+	// Faces above and below the chunk are never visible, so the bits past the top count as filled.
+	const int usedBits = dims.GetHeight() & 63;
+	const uint64 topPadding = usedBits == 0 ? 0 : ~((1ull << usedBits) - 1);
+
+	for (int i = 0; i < 6; i++) {
+		scratch.faceMasks[i].SetNumUninitialized(numOfColumns * numOfWords);
+	}
+
+	// A face is visible, where a meshed voxel meets an empty neighbour. Whole columns are checked with a few shifts.
+	const int neighbourOffsets[] = { paddedWidth, -paddedWidth, 1, -1 };
+	for (int y = 0; y < width; y++) {
+	for (int x = 0; x < width; x++) {
+		const int column = dims.GetColumn(x, y);
+		const int paddedColumn = (x + 1) + (y + 1) * paddedWidth;
+		const uint64* columnOccupancy = &occupancy[paddedColumn * numOfWords];
+		const uint64* columnSolid = &solid[column * numOfWords];
+
+		for (int w = 0; w < numOfWords; w++) {
+			uint64 filled = columnOccupancy[w] | (w == numOfWords - 1 ? topPadding : 0);
+			uint64 nextFilled = w + 1 < numOfWords ? columnOccupancy[w + 1] | (w + 1 == numOfWords - 1 ? topPadding : 0) : ~0ull;
+			uint64 previousFilled = w > 0 ? columnOccupancy[w - 1] : ~0ull;
+
+			uint64 above = (filled >> 1) | (nextFilled << 63);
+			uint64 below = (filled << 1) | (previousFilled >> 63);
+
+			scratch.faceMasks[0][column * numOfWords + w] = columnSolid[w] & ~above;
+			scratch.faceMasks[1][column * numOfWords + w] = columnSolid[w] & ~below;
+			for (int i = 2; i < 6; i++) {
+				scratch.faceMasks[i][column * numOfWords + w] = columnSolid[w] & ~occupancy[(paddedColumn + neighbourOffsets[i - 2]) * numOfWords + w];
+			}
+		}
+	}
+	}
+}
+
+void FChunkMesher::CullFaces(const FChunkMeshSnapshot& snapshot, bool bBitmask, FChunkMeshScratch& scratch, FChunkMeshResult& result) {
+
+	if (!bBitmask) {
+		BuildFaceMasksPerVoxel(snapshot, scratch, result);
+		return;
+	}
+
+	DispatchChunkDims(snapshot.chunkWidth, snapshot.chunkHeight, [&](const auto& dims) {
+		FScopeCycleCounter dimsCounter(dims.bStatic ? GET_STATID(STAT_VoxelFaceCullingStaticDims) : GET_STATID(STAT_VoxelFaceCullingDynamicDims));
+		BuildFaceMasks(dims, snapshot, scratch, result);
+	});
+}
+
+void FChunkMesher::BuildFaceMasksPerVoxel(const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch, FChunkMeshResult& result) {
+
+	SCOPE_CYCLE_COUNTER(STAT_VoxelFaceCullingPerVoxel);
+
+	const int numOfWords = GetNumOfWords(snapshot);
+	const int numOfColumns = snapshot.chunkWidth * snapshot.chunkWidth;
+	for (int i = 0; i < 6; i++) {
+		scratch.faceMasks[i].SetNumZeroed(numOfColumns * numOfWords);
+	}
+
+	// Check the six neighbours of every voxel one by one.
+	for (int x = 0; x < snapshot.chunkWidth; x++) {
+	for (int y = 0; y < snapshot.chunkWidth; y++) {
+	for (int z = 0; z < snapshot.chunkHeight; z++) {
+		int voxelAssetID = snapshot.voxelAssetIDs[x + y * snapshot.chunkWidth + z * snapshot.chunkWidthSquared];
+		if (voxelAssetID == 0) continue;
+		if (!IsSolidVoxelID(snapshot, voxelAssetID)) {
+			if (voxelAssetID > 0)
+				result.numOfInvalidVoxels++;
+			continue;
+		}
+
+		for (int i = 0; i < 6; i++) {
+			if (IsFaceVisible(snapshot, x, y, z, i))
+				scratch.faceMasks[i][(x + y * snapshot.chunkWidth) * numOfWords + (z >> 6)] |= 1ull << (z & 63);
+		}
+	}
+	}
+	}
+}
+
+bool FChunkMesher::HasVisibleFaces(const FChunkMeshSnapshot& snapshot, const FChunkMeshScratch& scratch, int zMin, int zMax) {
+
+	// Sections that are entirely air or entirely buried have no face bits.
+	const int numOfWords = GetNumOfWords(snapshot);
+	const int numOfColumns = snapshot.chunkWidth * snapshot.chunkWidth;
+	for (int w = zMin >> 6; w <= (zMax - 1) >> 6; w++) {
+		uint64 sectionBits = GetSectionBits(w, zMin, zMax);
+		for (int i = 0; i < 6; i++) {
+		for (int column = 0; column < numOfColumns; column++) {
+			if (scratch.faceMasks[i][column * numOfWords + w] & sectionBits)
+				return true;
+		}
+		}
+	}
+	return false;
+}
+
+uint64 FChunkMesher::GetSectionBits(int word, int zMin, int zMax) {
+
+	// Clamp the section to the heights covered by this word.
+	int lower = FMath::Max(zMin - word * 64, 0);
+	int upper = FMath::Min(zMax - word * 64, 64);
+	if (lower >= upper) return 0;
+
+	uint64 upperBits = upper == 64 ? ~0ull : (1ull << upper) - 1;
+	uint64 lowerBits = (1ull << lower) - 1;
+	return upperBits & ~lowerBits;
+}
+
+template<typename TDims>
+void FChunkMesher::BuildNaiveFaces(const TDims& dims, const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result) {
+
+	const TArray<int>& voxelAssetIDs = snapshot.voxelAssetIDs;
+	const int numOfWords = dims.GetNumOfWords();
+
+	// Add a quad for every set bit of the face masks inside this section.
+	for (int y = 0; y < dims.GetWidth(); y++) {
+	for (int x = 0; x < dims.GetWidth(); x++) {
+		int column = dims.GetColumn(x, y);
+
+		for (int i = 0; i < 6; i++) {
+		for (int w = zMin >> 6; w <= (zMax - 1) >> 6; w++) {
+			uint64 faces = scratch.faceMasks[i][column * numOfWords + w] & GetSectionBits(w, zMin, zMax);
+
+			while (faces) {
+				int z = w * 64 + (int)FPlatformMath::CountTrailingZeros64(faces);
+				faces &= faces - 1;
+
+				int voxelAssetID = voxelAssetIDs[dims.GetIndex(x, y, z)];
+
+				// Add the face spanning exactly this voxel.
+				FVector lower = FVector(snapshot.chunkOffset + x * snapshot.voxelSize, snapshot.chunkOffset + y * snapshot.voxelSize, -snapshot.voxelSizeHalved + z * snapshot.voxelSize);
+				FVector upper = FVector(snapshot.chunkOffset + (x + 1) * snapshot.voxelSize, snapshot.chunkOffset + (y + 1) * snapshot.voxelSize, (z + 1) * snapshot.voxelSize - snapshot.voxelSizeHalved);
+				AddVoxelFace(snapshot, scratch.voxelMeshInformation[voxelAssetID], i, lower, upper);
+			}
+		}
+		}
+	}
+	}
+}
+
+void FChunkMesher::BuildGreedyFaces(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result, FVoxelMeshInformation* mergedMesh) {
+
+	const TArray<int>& voxelAssetIDs = snapshot.voxelAssetIDs;
+
+	// The covered range of the section along the x, y and z axis.
+	const int lowerLimit[] = { 0, 0, zMin };
+	const int upperLimit[] = { snapshot.chunkWidth, snapshot.chunkWidth, zMax };
+	TArray<int>& mask = scratch.mask;
+	const int numOfWords = GetNumOfWords(snapshot);
+
+	for (int i = 0; i < 6; i++) {
+
+		// The axis along the face normal and the two axes spanning the face plane.
+		int axis = i < 2 ? 2 : (i < 4 ? 1 : 0);
+		int axisU = (axis + 1) % 3;
+		int axisV = (axis + 2) % 3;
+		int sizeU = upperLimit[axisU] - lowerLimit[axisU];
+		int sizeV = upperLimit[axisV] - lowerLimit[axisV];
+		mask.SetNumUninitialized(sizeU * sizeV);
+		const uint64* faceMask = scratch.faceMasks[i].GetData();
+
+		for (int slice = lowerLimit[axis]; slice < upperLimit[axis]; slice++) {
+
+			// Collect the asset ID of every visible face inside this slice.
+			for (int v = 0; v < sizeV; v++) {
+			for (int u = 0; u < sizeU; u++) {
+				int position[3];
+				position[axis] = slice;
+				position[axisU] = lowerLimit[axisU] + u;
+				position[axisV] = lowerLimit[axisV] + v;
+
+				int column = position[0] + position[1] * snapshot.chunkWidth;
+				bool visible = (faceMask[column * numOfWords + (position[2] >> 6)] >> (position[2] & 63)) & 1;
+				if (!visible)
+					mask[u + v * sizeU] = 0;
+				else
+					mask[u + v * sizeU] = mergedMesh ? 1 : voxelAssetIDs[column + position[2] * snapshot.chunkWidthSquared];
+			}
+			}
+
+			// Merge neighbouring faces of the same asset into rectangles.
+			for (int v = 0; v < sizeV; v++) {
+			for (int u = 0; u < sizeU; ) {
+				int voxelAssetID = mask[u + v * sizeU];
+				if (voxelAssetID == 0) {
+					u++;
+					continue;
+				}
+
+				// Grow the rectangle along U first.
+				int width = 1;
+				while (u + width < sizeU && mask[u + width + v * sizeU] == voxelAssetID)
+					width++;
+
+				// Then grow it along V as long as the whole row matches.
+				int height = 1;
+				for (; v + height < sizeV; height++) {
+					bool rowMatches = true;
+					for (int k = 0; k < width; k++) {
+						if (mask[u + k + (v + height) * sizeU] != voxelAssetID) {
+							rowMatches = false;
+							break;
+						}
+					}
+					if (!rowMatches) break;
+				}
+
+				// Consume the merged faces.
+				for (int h = 0; h < height; h++) {
+				for (int k = 0; k < width; k++) {
+					mask[u + k + (v + h) * sizeU] = 0;
+				}
+				}
+
+				// Convert the rectangle into voxel bounds and add it as a single face.
+				int lowerBound[3];
+				int upperBound[3];
+				lowerBound[axis] = slice;
+				upperBound[axis] = slice + 1;
+				lowerBound[axisU] = lowerLimit[axisU] + u;
+				upperBound[axisU] = lowerLimit[axisU] + u + width;
+				lowerBound[axisV] = lowerLimit[axisV] + v;
+				upperBound[axisV] = lowerLimit[axisV] + v + height;
+
+				FVector lower = FVector(snapshot.chunkOffset + lowerBound[0] * snapshot.voxelSize, snapshot.chunkOffset + lowerBound[1] * snapshot.voxelSize, -snapshot.voxelSizeHalved + lowerBound[2] * snapshot.voxelSize);
+				FVector upper = FVector(snapshot.chunkOffset + upperBound[0] * snapshot.voxelSize, snapshot.chunkOffset + upperBound[1] * snapshot.voxelSize, upperBound[2] * snapshot.voxelSize - snapshot.voxelSizeHalved);
+				AddVoxelFace(snapshot, mergedMesh ? *mergedMesh : scratch.voxelMeshInformation[voxelAssetID], i, lower, upper);
+
+				u += width;
+			}
+			}
+		}
+	}
+}
+
+void FChunkMesher::BuildSkirts(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch) {
+
+	const int numOfWords = GetNumOfWords(snapshot);
+	const int width = snapshot.chunkWidth;
+	for (int face = 2; face < 6; face++) {
+		if (!snapshot.skirtSides[face - 2]) continue;
+
+		for (int i = 0; i < width; i++) {
+			int x = face < 4 ? i : (face == 4 ? width - 1 : 0);
+			int y = face >= 4 ? i : (face == 2 ? width - 1 : 0);
+			int column = x + y * width;
+
+			// Every visible top face on the border starts a skirt. It belongs to the section of its top face.
+			for (int w = zMin >> 6; w <= (zMax - 1) >> 6; w++) {
+				uint64 tops = scratch.faceMasks[0][column * numOfWords + w] & GetSectionBits(w, zMin, zMax);
+
+				while (tops) {
+					int z = w * 64 + (int)FPlatformMath::CountTrailingZeros64(tops);
+					tops &= tops - 1;
+
+					// The skirt runs down the sides the neighbour hides, at most the skirt depth below the top cell.
+					// Visible sides already show their own faces, which a skirt would overlap.
+					int zBottom = z + 1;
+					while (zBottom > FMath::Max(z - snapshot.skirtDepth, 0)) {
+						int zBelow = zBottom - 1;
+						bool bSideVisible = (scratch.faceMasks[face][column * numOfWords + (zBelow >> 6)] >> (zBelow & 63)) & 1;
+						if (bSideVisible || !IsSolidVoxelID(snapshot, snapshot.voxelAssetIDs[column + zBelow * snapshot.chunkWidthSquared])) break;
+						zBottom = zBelow;
+					}
+					if (zBottom > z) continue;
+
+					int voxelAssetID = snapshot.voxelAssetIDs[column + z * snapshot.chunkWidthSquared];
+					FVector lower = FVector(snapshot.chunkOffset + x * snapshot.voxelSize, snapshot.chunkOffset + y * snapshot.voxelSize, -snapshot.voxelSizeHalved + zBottom * snapshot.voxelSize);
+					FVector upper = FVector(snapshot.chunkOffset + (x + 1) * snapshot.voxelSize, snapshot.chunkOffset + (y + 1) * snapshot.voxelSize, (z + 1) * snapshot.voxelSize - snapshot.voxelSizeHalved);
+					AddVoxelFace(snapshot, scratch.voxelMeshInformation[voxelAssetID], face, lower, upper);
+				}
+			}
+		}
+	}
+}
+
+bool FChunkMesher::IsFaceVisible(const FChunkMeshSnapshot& snapshot, int x, int y, int z, int face) {
+
+	// Faces on the outer x and y border of the chunk are checked against the neighbour.
+	int neighbourX = x + bMask[face][0];
+	int neighbourY = y + bMask[face][1];
+	if (neighbourX < 0 || neighbourX >= snapshot.chunkWidth || neighbourY < 0 || neighbourY >= snapshot.chunkWidth) {
+
+		// Without a neighbour the face is visible.
+		const TArray<int>& border = snapshot.neighbourBorders[face - 2];
+		if (border.Num() == 0)
+			return true;
+		return border[(face < 4 ? x : y) + z * snapshot.chunkWidth] < 1;
+	}
+
+	// Faces on the top and bottom of the chunk are never visible.
+	int neighbourIndex = neighbourX + neighbourY * snapshot.chunkWidth + (z + bMask[face][2]) * snapshot.chunkWidthSquared;
+	if (!snapshot.voxelAssetIDs.IsValidIndex(neighbourIndex))
+		return false;
+
+	// Otherwise the face is visible, if the neighbour is empty.
+	return snapshot.voxelAssetIDs[neighbourIndex] < 1;
+}
+
+bool FChunkMesher::IsSolidVoxelID(const FChunkMeshSnapshot& snapshot, int assetID) {
+	return assetID > 0 && snapshot.validAssetIDs.IsValidIndex(assetID) && snapshot.validAssetIDs[assetID];
+}
+
+void FChunkMesher::AddVoxelFace(const FChunkMeshSnapshot& snapshot, FVoxelMeshInformation& meshInformation, int face, const FVector& lower, const FVector& upper) {
+
+	// Add the two triangles of the face.
+	for (int t = 0; t < 6; t++) {
+		meshInformation.Triangles.Add(bTriangles[t] + meshInformation.elementID);
+	}
+	meshInformation.elementID += 4;
+
+	// Set the verticies for the face.
+	FVector corners[4];
+	for (int c = 0; c < 4; c++) {
+		corners[c] = FVector(
+			bCorners[face][c][0] ? upper.X : lower.X,
+			bCorners[face][c][1] ? upper.Y : lower.Y,
+			bCorners[face][c][2] ? upper.Z : lower.Z
+		);
+		meshInformation.Vertices.Add(corners[c]);
+	}
+	meshInformation.Normals.Append(bNormals[face], 4);
+
+	// Tile the UVs once per voxel, so merged faces keep the texture scale.
+	FVector2D tiling = FVector2D((corners[2] - corners[1]).Size() / snapshot.voxelSize, (corners[1] - corners[0]).Size() / snapshot.voxelSize);
+	for (int c = 0; c < 4; c++) {
+		meshInformation.UVs.Add(bUVs[c] * tiling);
+	}
+
+	// Add the color informations to the face.
+	FColor color = FColor(255, 255, 255, face);
+	for (int c = 0; c < 4; c++) {
+		meshInformation.VertexColors.Add(color);
+	}
+}
+
+/// ------ Task ------ \\\
+
+void FChunkMeshTask::DoWork() {
+
+	// Build the mesh from the immutable snapshot and hand it over to the game thread.
+	FChunkMesher::BuildMesh(*snapshot, *result);
+	resultQueue->Enqueue(result);
+}
@@ -0,0 +1,278 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "../VoxelWorld.h"
+#include "ProceduralMeshComponent.h"
+#include "ChunkDimensions.h"
+#include "Async/AsyncWork.h"
+#include "Containers/Queue.h"
+
+// Forward-Declarations
+class AChunkActor;
+
+/* This struct stores all necessary information to create a procedural mesh. */
+struct FVoxelMeshInformation {
+	TArray<FVector> Vertices;
+	TArray<int> Triangles;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UVs;
+	TArray<FColor> VertexColors;
+	TArray<FProcMeshTangent> Tangents;
+	int elementID = 0;
+
+	// A checksum of the vertex data to detect unchanged meshes.
+	uint32 hash = 0;
+};
+
+/* An immutable copy of everything the mesher needs to know about a chunk. */
+struct FChunkMeshSnapshot {
+
+	// The asset IDs of every voxel inside the chunk at the time of the snapshot.
+	TArray<int> voxelAssetIDs;
+
+	// Flags for every asset ID, if a valid voxel asset is assigned to it.
+	TArray<bool> validAssetIDs;
+
+	// The size of a single voxel in unreal units.
+	int voxelSize = 100;
+
+	// The size of a single voxel divided by two. Also the vertical offset of the voxel grid.
+	int voxelSizeHalved = 50;
+
+	// The width of the chunk in voxels.
+	int chunkWidth = 16;
+
+	// The squared value of the chunk width.
+	int chunkWidthSquared = 256;
+
+	// The height of the chunk in voxels.
+	int chunkHeight = 128;
+
+	// The relative offset around the chunk center.
+	int chunkOffset = -800;
+
+	// The height of a single vertical section in voxels.
+	int sectionHeight = 16;
+
+	// The voxel layers of the neighbours on the +Y, -Y, +X and -X side, starting with the touching one. Empty, if no neighbour exists.
+	TArray<int> neighbourBorders[4];
+
+	// The cell size every neighbour is meshed with. Its border holds as many layers, so the mesher can rebuild the cells the neighbour shows.
+	int neighbourCellSizes[4] = { 1, 1, 1, 1 };
+
+	// Flags for every vertical section, if all of its voxels share one asset ID.
+	TArray<bool> uniformSections;
+
+	// The indices of the vertical sections that need to be rebuilt.
+	TArray<int> dirtySections;
+
+	// The vertex count of every procedural mesh section after the previous build. Used to reserve the build buffers.
+	TArray<int> vertexCountHints;
+
+	// Should coplanar faces of the same asset be merged into larger quads.
+	bool bGreedyMeshing = false;
+
+	// The level of detail. Every level doubles the size of the meshed cells.
+	int lodLevel = 0;
+
+	// The depth in cells the skirts reach below the surface.
+	int skirtDepth = 0;
+
+	// Flags for the +Y, -Y, +X and -X side, if the neighbour is meshed with another cell size and cracks along the seam need a skirt.
+	// Set by the mesher, when it resolves the neighbour borders.
+	bool skirtSides[4] = { false, false, false, false };
+
+	// Should a collision mesh be built for every section.
+	bool bBuildCollision = false;
+
+	// Should the collision mesh merge the faces of all assets into larger quads instead of using the render triangles.
+	bool bSimplifiedCollision = true;
+};
+
+/* The mesh of a single vertical section of a chunk. */
+struct FChunkSectionMesh {
+
+	// The index of the vertical section.
+	int sectionIndex = 0;
+
+	// The mesh information of every voxel asset. Empty, if the section was skipped.
+	TArray<FVoxelMeshInformation> voxelMeshInformation;
+
+	// Has a collision mesh been built for this section.
+	bool bHasCollision = false;
+
+	// The collision mesh of the whole section. Only the vertices and triangles are filled.
+	FVoxelMeshInformation collisionMeshInformation;
+};
+
+/* The outcome of a single mesh build. */
+struct FChunkMeshResult {
+
+	// The chunk the mesh was built for.
+	TWeakObjectPtr<AChunkActor> chunk;
+
+	// The mesh revision of the chunk at the time of the request.
+	int revision = 0;
+
+	// The rebuilt vertical sections.
+	TArray<FChunkSectionMesh> sections;
+
+	// The number of voxels that were skipped because of an invalid asset ID.
+	int numOfInvalidVoxels = 0;
+
+	// The number of heap allocations the build needed.
+	int numOfAllocations = 0;
+};
+
+/* Reusable buffers of a single thread to build meshes without allocating. */
+struct FChunkMeshScratch {
+
+	// The mesh information of every voxel asset of the section that is currently built.
+	TArray<FVoxelMeshInformation> voxelMeshInformation;
+
+	// The face mask of the greedy mesher.
+	TArray<int> mask;
+
+	// The collision mesh of the section that is currently built.
+	FVoxelMeshInformation collisionMeshInformation;
+
+	// One bit per filled voxel along every column, including a ring of neighbour columns.
+	TArray<uint64> occupancy;
+
+	// One bit per meshed voxel along every column.
+	TArray<uint64> solid;
+
+	// One bit per visible face along every column for each face direction (+Z, -Z, +Y, -Y, +X, -X).
+	TArray<uint64> faceMasks[6];
+
+	// The downsampled grid of chunks with a level of detail or with coarser neighbours.
+	FChunkMeshSnapshot lodSnapshot;
+
+	// The filled cells of the neighbour border that is currently resolved.
+	TArray<bool> neighbourCells;
+
+	// Receive the scratch buffers of the calling thread.
+	static FChunkMeshScratch& Get();
+
+	// Empty the buffers for the next section while keeping their memory and reserve at least the given capacity.
+	// @return - The number of buffers that had to allocate.
+	int Prepare(int numOfAssets, const int* vertexCountHints);
+
+	// Count the buffers that had to allocate since the last call.
+	// @return - The number of buffers that grew.
+	int CountGrownBuffers();
+
+private:
+	// The capacity of every buffer after the last check.
+	TArray<int> capacities;
+};
+
+typedef TSharedPtr<const FChunkMeshSnapshot, ESPMode::ThreadSafe> FChunkMeshSnapshotPtr;
+typedef TSharedPtr<FChunkMeshResult, ESPMode::ThreadSafe> FChunkMeshResultPtr;
+typedef TQueue<FChunkMeshResultPtr, EQueueMode::Mpsc> FChunkMeshResultQueue;
+
+// The function manager to build the mesh of a chunk. Only works on snapshots, so it can run on any thread.
+class FChunkMesher {
+
+	// The console benchmarks of development builds run single build steps.
+	friend struct FVoxelBenchmarks;
+
+public:
+	// Build the mesh information for every voxel asset of the dirty sections of the given snapshot.
+	static void BuildMesh(const FChunkMeshSnapshot& snapshot, FChunkMeshResult& result);
+
+	// Calculate the size of the meshed cells for a level of detail. The cells have to split the chunk width evenly.
+	// @return - The size of a cell in voxels.
+	static int GetCellSize(int chunkWidth, int lodLevel);
+
+private:
+	// Downsample the voxels into the scratch grid with cells of two to the power of the level of detail. Every cell takes the most common asset ID, if at least half of it is filled.
+	// @return - The size of a cell in voxels.
+	static int DownsampleSnapshot(const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch);
+
+	// Rebuild the border cells every neighbour shows and downsample them into single layers of the scratch grid.
+	// A cell of such a layer is only filled, if the neighbour covers it completely, so partly covered faces stay visible.
+	static void ResolveNeighbourBorders(const FChunkMeshSnapshot& snapshot, int cellSize, FChunkMeshScratch& scratch);
+
+	// Find the visible faces of every voxel with the column bitmasks or with the per voxel checks.
+	static void CullFaces(const FChunkMeshSnapshot& snapshot, bool bBitmask, FChunkMeshScratch& scratch, FChunkMeshResult& result);
+
+	// Pack the chunk into one bit per voxel along every column and find the visible faces of whole columns with shifts and masks.
+	// The dimensions are either specialised at compile time or the runtime fallback.
+	template<typename TDims>
+	static void BuildFaceMasks(const TDims& dims, const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch, FChunkMeshResult& result);
+
+	// Find the visible faces by checking the neighbours of every voxel. Reference for the bitmask culling.
+	static void BuildFaceMasksPerVoxel(const FChunkMeshSnapshot& snapshot, FChunkMeshScratch& scratch, FChunkMeshResult& result);
+
+	// Check, if the section between the given heights has any visible face. Sections that are entirely air or entirely buried have none.
+	static bool HasVisibleFaces(const FChunkMeshSnapshot& snapshot, const FChunkMeshScratch& scratch, int zMin, int zMax);
+
+	// Calculate the bits of a column word that lie between the given heights.
+	static uint64 GetSectionBits(int word, int zMin, int zMax);
+
+	// Calculate the number of 64 bit words per column.
+	static int GetNumOfWords(const FChunkMeshSnapshot& snapshot) {
+		return (snapshot.chunkHeight + 63) / 64;
+	}
+
+	// Add one quad per visible voxel face between the given heights to the mesh information.
+	template<typename TDims>
+	static void BuildNaiveFaces(const TDims& dims, const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result);
+
+	// Merge visible coplanar faces of the same voxel asset between the given heights into rectangles and add them to the mesh information.
+	// If a merged mesh is given, faces of all assets are merged and added to it instead.
+	static void BuildGreedyFaces(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result, FVoxelMeshInformation* mergedMesh = nullptr);
+
+	// Add a skirt below every visible top face on the sides towards neighbours with another cell size.
+	// The skirts only cover sides the neighbour hides, so they fill the cracks along the seam without overlapping visible faces.
+	static void BuildSkirts(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch);
+
+	// Build the collision mesh of the section between the given heights into the scratch buffers.
+	static void BuildCollision(const FChunkMeshSnapshot& snapshot, int zMin, int zMax, FChunkMeshScratch& scratch, FChunkMeshResult& result);
+
+	// Copy the built mesh information from the scratch buffers into the section with exactly one allocation per buffer.
+	// @return - The number of allocations.
+	static int CopyToSection(const FChunkMeshScratch& scratch, int numOfAssets, FChunkSectionMesh& section);
+
+	// Check, if the given face (+Z, -Z, +Y, -Y, +X, -X) of a voxel is exposed.
+	static bool IsFaceVisible(const FChunkMeshSnapshot& snapshot, int x, int y, int z, int face);
+
+	// Check, if the given asset ID belongs to a voxel that should be meshed.
+	static bool IsSolidVoxelID(const FChunkMeshSnapshot& snapshot, int assetID);
+
+	// Add a single quad spanning the given box to the mesh information.
+	static void AddVoxelFace(const FChunkMeshSnapshot& snapshot, FVoxelMeshInformation& meshInformation, int face, const FVector& lower, const FVector& upper);
+};
+
+// The background task that builds the mesh of a single chunk snapshot.
+class FChunkMeshTask : public FNonAbandonableTask {
+
+	friend class FAutoDeleteAsyncTask<FChunkMeshTask>;
+
+	// The snapshot to build the mesh from.
+	FChunkMeshSnapshotPtr snapshot;
+
+	// The result that is handed back to the game thread.
+	FChunkMeshResultPtr result;
+
+	// The queue the finished result is added to.
+	TSharedPtr<FChunkMeshResultQueue, ESPMode::ThreadSafe> resultQueue;
+
+public:
+	// The default constructor. Also sets the internal variables.
+	FChunkMeshTask(FChunkMeshSnapshotPtr snapshot, FChunkMeshResultPtr result, TSharedPtr<FChunkMeshResultQueue, ESPMode::ThreadSafe> resultQueue)
+		: snapshot(snapshot)
+		, result(result)
+		, resultQueue(resultQueue)
+	{}
+
+	// Build the mesh and hand it over to the queue.
+	void DoWork();
+
+	FORCEINLINE TStatId GetStatId() const {
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FChunkMeshTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+};
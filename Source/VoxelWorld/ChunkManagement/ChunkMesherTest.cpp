@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkMesher.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// A 16 x 16 x 128 chunk with a floor of asset 1 up to Z = 3 and a 2 x 2 x 2 block of asset 2 on top of it.
+static FChunkMeshSnapshot CreateTestSnapshot(bool bGreedyMeshing) {
+
+	FChunkMeshSnapshot snapshot;
+	snapshot.validAssetIDs = { false, true, true };
+	snapshot.voxelAssetIDs.SetNumZeroed(snapshot.chunkWidthSquared * snapshot.chunkHeight);
+	snapshot.bGreedyMeshing = bGreedyMeshing;
+
+	for (int z = 0; z < 6; z++) {
+	for (int y = 0; y < snapshot.chunkWidth; y++) {
+	for (int x = 0; x < snapshot.chunkWidth; x++) {
+		int index = x + y * snapshot.chunkWidth + z * snapshot.chunkWidthSquared;
+		if (z < 4)
+			snapshot.voxelAssetIDs[index] = 1;
+		else if (x >= 4 && x < 6 && y >= 4 && y < 6)
+			snapshot.voxelAssetIDs[index] = 2;
+	}
+	}
+	}
+
+	for (int s = 0; s < snapshot.chunkHeight / snapshot.sectionHeight; s++) {
+		snapshot.dirtySections.Add(s);
+		snapshot.uniformSections.Add(false);
+	}
+	return snapshot;
+}
+
+// Split every quad of the mesh into the voxel faces it covers, packed as face, asset ID, X, Y and Z.
+static void CollectVoxelFaces(const FChunkMeshSnapshot& snapshot, const FChunkMeshResult& result, TArray<uint64>& voxelFaces, int& numOfTriangles) {
+
+	const FVector normals[] = { FVector(0, 0, 1), FVector(0, 0, -1), FVector(0, 1, 0), FVector(0, -1, 0), FVector(1, 0, 0), FVector(-1, 0, 0) };
+
+	for (const FChunkSectionMesh& section : result.sections) {
+	for (int assetID = 0; assetID < section.voxelMeshInformation.Num(); assetID++) {
+		const FVoxelMeshInformation& meshInformation = section.voxelMeshInformation[assetID];
+		numOfTriangles += meshInformation.Triangles.Num() / 3;
+
+		for (int q = 0; q + 3 < meshInformation.Vertices.Num(); q += 4) {
+			int face = 0;
+			while (face < 5 && !meshInformation.Normals[q].Equals(normals[face])) face++;
+
+			// The corners of the quad in voxel units.
+			FIntVector lower = FIntVector(MAX_int32, MAX_int32, MAX_int32);
+			FIntVector upper = FIntVector(MIN_int32, MIN_int32, MIN_int32);
+			for (int c = 0; c < 4; c++) {
+				const FVector& vertex = meshInformation.Vertices[q + c];
+				FIntVector corner = FIntVector(
+					FMath::RoundToInt((vertex.X - snapshot.chunkOffset) / snapshot.voxelSize),
+					FMath::RoundToInt((vertex.Y - snapshot.chunkOffset) / snapshot.voxelSize),
+					FMath::RoundToInt((vertex.Z + snapshot.voxelSizeHalved) / snapshot.voxelSize)
+				);
+				lower = FIntVector(FMath::Min(lower.X, corner.X), FMath::Min(lower.Y, corner.Y), FMath::Min(lower.Z, corner.Z));
+				upper = FIntVector(FMath::Max(upper.X, corner.X), FMath::Max(upper.Y, corner.Y), FMath::Max(upper.Z, corner.Z));
+			}
+
+			// The quad lies on the upper side of the voxels for positive faces.
+			int axis = face < 2 ? 2 : (face < 4 ? 1 : 0);
+			if (face % 2 == 0)
+				lower[axis]--;
+			else
+				upper[axis]++;
+
+			for (int z = lower.Z; z < upper.Z; z++) {
+			for (int y = lower.Y; y < upper.Y; y++) {
+			for (int x = lower.X; x < upper.X; x++) {
+				voxelFaces.Add(((uint64)face << 48) | ((uint64)assetID << 40) | ((uint64)x << 32) | ((uint64)y << 24) | (uint64)z);
+			}
+			}
+			}
+		}
+	}
+	}
+	voxelFaces.Sort();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FChunkMesherGreedyTest, "VoxelWorld.ChunkMesher.GreedyMeshing", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FChunkMesherGreedyTest::RunTest(const FString& Parameters) {
+
+	FChunkMeshResult naiveResult;
+	FChunkMeshSnapshot naiveSnapshot = CreateTestSnapshot(false);
+	FChunkMesher::BuildMesh(naiveSnapshot, naiveResult);
+
+	FChunkMeshResult greedyResult;
+	FChunkMeshSnapshot greedySnapshot = CreateTestSnapshot(true);
+	FChunkMesher::BuildMesh(greedySnapshot, greedyResult);
+
+	TArray<uint64> naiveFaces, greedyFaces;
+	int numOfNaiveTriangles = 0;
+	int numOfGreedyTriangles = 0;
+	CollectVoxelFaces(naiveSnapshot, naiveResult, naiveFaces, numOfNaiveTriangles);
+	CollectVoxelFaces(greedySnapshot, greedyResult, greedyFaces, numOfGreedyTriangles);
+
+	// The floor has a top split into 4 rectangles around the block and 4 sides. The block has a top and 4 sides.
+	TestEqual(TEXT("Greedy triangles"), numOfGreedyTriangles, 26);
+
+	// One quad per visible voxel face: 252 floor tops, 4 block tops, 4 x 16 x 4 floor sides and 4 x 2 x 2 block sides.
+	TestEqual(TEXT("Naive triangles"), numOfNaiveTriangles, 2 * (252 + 4 + 256 + 16));
+
+	// The merged rectangles cover exactly the faces of the naive mesh, without overlapping each other.
+	TestEqual(TEXT("Covered voxel faces"), greedyFaces.Num(), naiveFaces.Num());
+	TestTrue(TEXT("Greedy mesh covers the naive faces"), greedyFaces == naiveFaces);
+	return true;
+}
+
+#endif
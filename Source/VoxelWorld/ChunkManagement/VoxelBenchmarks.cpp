@@ -0,0 +1,314 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ChunkMesher.h"
+#include "VoxelSectionStorage.h"
+#include "HAL/IConsoleManager.h"
+
+#if !UE_BUILD_SHIPPING
+
+#if PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* The console benchmarks of development builds. A friend of the mesher, so single build steps can be measured. */
+struct FVoxelBenchmarks {
+
+	// Fill a snapshot with rolling hills of three assets, scattered caves and neighbours on every side, like a generated chunk.
+	static void CreateBenchmarkSnapshot(int width, int height, FChunkMeshSnapshot& snapshot);
+
+	// Cull the same chunk with the column bitmasks and with the per voxel checks and log both timings, e.g. "voxel.BenchmarkFaceCulling 200".
+	static void BenchmarkFaceCulling(const TArray<FString>& args);
+
+	// Mesh the same chunks with the compile time and the runtime dimensions and log both timings, e.g. "voxel.BenchmarkChunkDims 200".
+	static void BenchmarkChunkDims(const TArray<FString>& args);
+
+	// Store the same chunk in the linear and in the brick layout and log the mesh and neighbour read timings of both, e.g. "voxel.BenchmarkVoxelLayout 200".
+	static void BenchmarkVoxelLayout(const TArray<FString>& args);
+};
+
+// Counts the cache misses of the calling thread. Only Linux exposes them to user code (through perf events).
+struct FCacheMissCounter {
+
+	int handle = -1;
+
+	FCacheMissCounter() {
+#if PLATFORM_LINUX
+		perf_event_attr attributes;
+		FMemory::Memzero(&attributes, sizeof(attributes));
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		handle = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+	}
+
+	~FCacheMissCounter() {
+#if PLATFORM_LINUX
+		if (handle >= 0)
+			close(handle);
+#endif
+	}
+
+	void Start() {
+#if PLATFORM_LINUX
+		if (handle < 0) return;
+		ioctl(handle, PERF_EVENT_IOC_RESET, 0);
+		ioctl(handle, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	// @return - The cache misses since the start as text. "n/a", if the platform doesn't count them.
+	FString Stop(int numOfRuns) {
+#if PLATFORM_LINUX
+		int64 misses = 0;
+		if (handle >= 0) {
+			ioctl(handle, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(handle, &misses, sizeof(misses)) == sizeof(misses))
+				return FString::Printf(TEXT("%lld"), misses / numOfRuns);
+		}
+#endif
+		return FString(TEXT("n/a"));
+	}
+};
+
+// Sets an integer console variable for its lifetime and restores the previous value afterwards.
+struct FScopedConsoleVariable {
+
+	IConsoleVariable* variable = nullptr;
+	int32 previousValue = 0;
+
+	FScopedConsoleVariable(const TCHAR* name, int32 value) {
+		variable = IConsoleManager::Get().FindConsoleVariable(name);
+		if (!variable) return;
+
+		// Keep the priority it was set with, so the console can't block the change.
+		previousValue = variable->GetInt();
+		variable->Set(value, (EConsoleVariableFlags)(variable->GetFlags() & ECVF_SetByMask));
+	}
+
+	~FScopedConsoleVariable() {
+		if (variable)
+			variable->Set(previousValue, (EConsoleVariableFlags)(variable->GetFlags() & ECVF_SetByMask));
+	}
+};
+
+
+/// ------ Mesher ------ \\\
+
+void FVoxelBenchmarks::CreateBenchmarkSnapshot(int width, int height, FChunkMeshSnapshot& snapshot) {
+
+	FRandomStream random(1337);
+	snapshot.validAssetIDs = { false, true, true, true };
+	snapshot.chunkWidth = width;
+	snapshot.chunkWidthSquared = width * width;
+	snapshot.chunkHeight = height;
+	snapshot.chunkOffset = -width * snapshot.voxelSize / 2;
+
+	snapshot.voxelAssetIDs.SetNumUninitialized(width * width * height);
+	for (int z = 0; z < height; z++) {
+	for (int y = 0; y < width; y++) {
+	for (int x = 0; x < width; x++) {
+		int surface = height / 2 + FMath::RoundToInt(height / 8 * FMath::Sin(x * 0.4f) * FMath::Cos(y * 0.3f));
+		int voxelAssetID = z > surface ? 0 : (z == surface ? 1 : (z > surface - 4 ? 2 : 3));
+		if (voxelAssetID == 3 && random.FRand() < 0.1f)
+			voxelAssetID = 0;
+		snapshot.voxelAssetIDs[x + y * width + z * width * width] = voxelAssetID;
+	}
+	}
+	}
+
+	// The neighbours continue the chunk, as if it was repeated on every side.
+	for (int face = 2; face < 6; face++) {
+		TArray<int>& border = snapshot.neighbourBorders[face - 2];
+		border.SetNumUninitialized(width * height);
+		for (int z = 0; z < height; z++) {
+		for (int i = 0; i < width; i++) {
+			int x = face < 4 ? i : (face == 4 ? 0 : width - 1);
+			int y = face >= 4 ? i : (face == 2 ? 0 : width - 1);
+			border[i + z * width] = snapshot.voxelAssetIDs[x + y * width + z * width * width];
+		}
+		}
+	}
+
+	snapshot.uniformSections.Reset();
+	snapshot.dirtySections.Reset();
+	for (int zMin = 0; zMin < height; zMin += snapshot.sectionHeight) {
+		bool bUniform = true;
+		for (int i = zMin * width * width; i < FMath::Min(zMin + snapshot.sectionHeight, height) * width * width && bUniform; i++) {
+			bUniform = snapshot.voxelAssetIDs[i] == snapshot.voxelAssetIDs[zMin * width * width];
+		}
+		snapshot.uniformSections.Add(bUniform);
+		snapshot.dirtySections.Add(zMin / snapshot.sectionHeight);
+	}
+}
+
+void FVoxelBenchmarks::BenchmarkFaceCulling(const TArray<FString>& args) {
+
+	const int numOfRuns = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 200;
+	FChunkMeshSnapshot snapshot;
+	CreateBenchmarkSnapshot(16, 128, snapshot);
+	FChunkMeshScratch& scratch = FChunkMeshScratch::Get();
+	FChunkMeshResult result;
+
+	double start = FPlatformTime::Seconds();
+	for (int run = 0; run < numOfRuns; run++) {
+		FChunkMesher::CullFaces(snapshot, false, scratch, result);
+	}
+	double perVoxelTime = FPlatformTime::Seconds() - start;
+
+	// Keep the masks of the per voxel checks to compare them with the bitmasks.
+	TArray<uint64> perVoxelMasks[6];
+	for (int i = 0; i < 6; i++) {
+		perVoxelMasks[i] = scratch.faceMasks[i];
+	}
+
+	start = FPlatformTime::Seconds();
+	for (int run = 0; run < numOfRuns; run++) {
+		FChunkMesher::CullFaces(snapshot, true, scratch, result);
+	}
+	double bitmaskTime = FPlatformTime::Seconds() - start;
+
+	bool bMatching = true;
+	for (int i = 0; i < 6; i++) {
+		bMatching &= perVoxelMasks[i] == scratch.faceMasks[i];
+	}
+	UE_LOG(LogTemp, Display, TEXT("FaceCulling: %d runs, per voxel %.3f ms/chunk, bitmask %.3f ms/chunk, %.1fx faster, %s masks"),
+		numOfRuns, perVoxelTime / numOfRuns * 1000.0, bitmaskTime / numOfRuns * 1000.0, perVoxelTime / bitmaskTime, bMatching ? TEXT("matching") : TEXT("different"));
+}
+
+static FAutoConsoleCommand BenchmarkFaceCullingCommand(
+	TEXT("voxel.BenchmarkFaceCulling"),
+	TEXT("Culls the faces of the same chunk with the column bitmasks and with the per voxel checks and logs both timings. Takes the number of runs."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FVoxelBenchmarks::BenchmarkFaceCulling));
+
+void FVoxelBenchmarks::BenchmarkChunkDims(const TArray<FString>& args) {
+
+	const int numOfRuns = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 200;
+
+	// Count the vertices of a full mesh build with the selected dimensions.
+	auto MeshChunk = [](const FChunkMeshSnapshot& snapshot, FChunkMeshResult& result) {
+		FChunkMesher::BuildMesh(snapshot, result);
+
+		int numOfVertices = 0;
+		for (const FChunkSectionMesh& section : result.sections) {
+		for (const FVoxelMeshInformation& meshInformation : section.voxelMeshInformation) {
+			numOfVertices += meshInformation.Vertices.Num();
+		}
+		}
+		return numOfVertices;
+	};
+
+	// Every specialised size is meshed by the real mesh build, once as it is and once forced to the runtime dimensions.
+	const FIntPoint sizes[] = { FIntPoint(16, 128), FIntPoint(32, 256) };
+	for (const FIntPoint& size : sizes) {
+		FChunkMeshSnapshot snapshot;
+		FChunkMeshResult result;
+		CreateBenchmarkSnapshot(size.X, size.Y, snapshot);
+
+		// Warm up the scratch buffers, so neither path pays for their allocations.
+		int staticVertices = MeshChunk(snapshot, result);
+		double start = FPlatformTime::Seconds();
+		for (int run = 0; run < numOfRuns; run++) {
+			MeshChunk(snapshot, result);
+		}
+		double staticTime = FPlatformTime::Seconds() - start;
+
+		int dynamicVertices = 0;
+		double dynamicTime = 0.0;
+		{
+			FScopedConsoleVariable forceDynamicDims(TEXT("voxel.ForceDynamicChunkDims"), 1);
+			dynamicVertices = MeshChunk(snapshot, result);
+			start = FPlatformTime::Seconds();
+			for (int run = 0; run < numOfRuns; run++) {
+				MeshChunk(snapshot, result);
+			}
+			dynamicTime = FPlatformTime::Seconds() - start;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("ChunkDims %dx%d: %d runs, static %.3f ms/chunk, dynamic %.3f ms/chunk, %.2fx faster, %s vertices"),
+			size.X, size.Y, numOfRuns, staticTime / numOfRuns * 1000.0, dynamicTime / numOfRuns * 1000.0,
+			dynamicTime / staticTime, staticVertices == dynamicVertices ? TEXT("matching") : TEXT("different"));
+	}
+}
+
+static FAutoConsoleCommand BenchmarkChunkDimsCommand(
+	TEXT("voxel.BenchmarkChunkDims"),
+	TEXT("Meshes the same chunks with the compile time and the runtime chunk dimensions and logs both timings. Takes the number of runs."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FVoxelBenchmarks::BenchmarkChunkDims));
+
+
+/// ------ Section Storage ------ \\\
+
+void FVoxelBenchmarks::BenchmarkVoxelLayout(const TArray<FString>& args) {
+
+	const int numOfRuns = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 200;
+	FChunkMeshSnapshot reference;
+	CreateBenchmarkSnapshot(16, 128, reference);
+	const int width = reference.chunkWidth;
+	const int height = reference.chunkHeight;
+	const int neighbourOffsets[6][3] = { {0,0,1}, {0,0,-1}, {0,1,0}, {0,-1,0}, {1,0,0}, {-1,0,0} };
+	FCacheMissCounter cacheMisses;
+
+	const EVoxelLayout layouts[] = { EVoxelLayout::Linear, EVoxelLayout::Bricks };
+	for (EVoxelLayout layoutType : layouts) {
+		FVoxelSectionStorage storage;
+		storage.Init(width, height, reference.sectionHeight, layoutType);
+		for (int index = 0; index < reference.voxelAssetIDs.Num(); index++) {
+			storage.Set(index, reference.voxelAssetIDs[index]);
+		}
+
+		// Decode and mesh the whole chunk, like a mesh build of a chunk actor.
+		FChunkMeshSnapshot snapshot = reference;
+		FChunkMeshResult result;
+		cacheMisses.Start();
+		double start = FPlatformTime::Seconds();
+		for (int run = 0; run < numOfRuns; run++) {
+			storage.CopyTo(snapshot.voxelAssetIDs);
+			for (int s = 0; s < storage.GetNumOfSections(); s++) {
+				snapshot.uniformSections[s] = storage.IsSectionUniform(s);
+			}
+			FChunkMesher::BuildMesh(snapshot, result);
+		}
+		double meshTime = FPlatformTime::Seconds() - start;
+		FString meshMisses = cacheMisses.Stop(numOfRuns);
+
+		// Read the six neighbours of every voxel, like edits and queries on the stored voxels.
+		int64 checksum = 0;
+		cacheMisses.Start();
+		start = FPlatformTime::Seconds();
+		for (int run = 0; run < numOfRuns; run++) {
+			for (int z = 0; z < height; z++) {
+			for (int y = 0; y < width; y++) {
+			for (int x = 0; x < width; x++) {
+				for (int face = 0; face < 6; face++) {
+					int neighbourX = x + neighbourOffsets[face][0];
+					int neighbourY = y + neighbourOffsets[face][1];
+					int neighbourZ = z + neighbourOffsets[face][2];
+					if (neighbourX < 0 || neighbourX >= width || neighbourY < 0 || neighbourY >= width || neighbourZ < 0 || neighbourZ >= height) continue;
+					checksum += storage.Get(neighbourX, neighbourY, neighbourZ);
+				}
+			}
+			}
+			}
+		}
+		double readTime = FPlatformTime::Seconds() - start;
+		FString readMisses = cacheMisses.Stop(numOfRuns);
+
+		UE_LOG(LogTemp, Display, TEXT("VoxelLayout %s: %d runs, decode and mesh %.3f ms/chunk (%s cache misses), neighbour reads %.3f ms/chunk (%s cache misses), checksum %lld"),
+			layoutType == EVoxelLayout::Linear ? TEXT("Linear") : TEXT("Bricks"), numOfRuns, meshTime / numOfRuns * 1000.0, *meshMisses,
+			readTime / numOfRuns * 1000.0, *readMisses, checksum / numOfRuns);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkVoxelLayoutCommand(
+	TEXT("voxel.BenchmarkVoxelLayout"),
+	TEXT("Stores the same chunk in the linear and in the brick layout and logs the mesh and neighbour read timings and cache misses of both. Takes the number of runs."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FVoxelBenchmarks::BenchmarkVoxelLayout));
+
+#endif
@@ -0,0 +1,417 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelColumnGenerator.h"
+#include "HAL/IConsoleManager.h"
+#include "../VoxelWorld.h"
+
+DECLARE_CYCLE_STAT(TEXT("Calculate Density"), STAT_VoxelCalculateDensity, STATGROUP_VoxelWorld);
+
+void FVoxelFractalNoise::Generate(const FSimplexNoiseContext& context, const FIntPoint& firstColumn, int size, float* result) const {
+
+	TArray<float> octave;
+	octave.SetNumUninitialized(size * size);
+	FMemory::Memzero(result, size * size * sizeof(float));
+
+	float frequency = scale;
+	float weight = 1.0f;
+	float totalWeight = 0.0f;
+	for (int i = 0; i < FMath::Max(octaves, 1); i++) {
+
+		// Every octave samples another part of the noise, otherwise they would line up around the origin.
+		FVector2D origin = (FVector2D(firstColumn.X, firstColumn.Y) + FVector2D(i * 311.7f, i * 187.3f)) * frequency;
+		context.Noise2DGrid(origin, frequency, size, size, octave.GetData());
+
+		for (int column = 0; column < size * size; column++) {
+			float value = octave[column];
+			if (bRidged) {
+				value = 1.0f - FMath::Abs(value);
+				value *= value;
+			}
+			result[column] += value * weight;
+		}
+
+		totalWeight += weight;
+		frequency *= lacunarity;
+		weight *= gain;
+	}
+
+	// Normalize the sum, ridges lie between 0 and 1 before.
+	for (int column = 0; column < size * size; column++) {
+		result[column] = bRidged ? result[column] / totalWeight * 2.0f - 1.0f : result[column] / totalWeight;
+	}
+}
+
+void FVoxelFractalNoise::Generate3D(const FSimplexNoiseContext& context, const TArray<FVector>& points, float* result) const {
+
+	const int numOfPoints = points.Num();
+	TArray<float> x, y, z, octave;
+	x.SetNumUninitialized(numOfPoints);
+	y.SetNumUninitialized(numOfPoints);
+	z.SetNumUninitialized(numOfPoints);
+	octave.SetNumUninitialized(numOfPoints);
+	FMemory::Memzero(result, numOfPoints * sizeof(float));
+
+	float frequency = scale;
+	float weight = 1.0f;
+	float totalWeight = 0.0f;
+	for (int i = 0; i < FMath::Max(octaves, 1); i++) {
+
+		// Every octave samples another part of the noise, like the 2D noise.
+		FVector offset(i * 311.7f, i * 187.3f, i * 97.1f);
+		for (int point = 0; point < numOfPoints; point++) {
+			x[point] = (points[point].X + offset.X) * frequency;
+			y[point] = (points[point].Y + offset.Y) * frequency;
+			z[point] = (points[point].Z + offset.Z) * frequency;
+		}
+		context.Noise3DArray(x.GetData(), y.GetData(), z.GetData(), octave.GetData(), numOfPoints);
+
+		for (int point = 0; point < numOfPoints; point++) {
+			float value = octave[point];
+			if (bRidged) {
+				value = 1.0f - FMath::Abs(value);
+				value *= value;
+			}
+			result[point] += value * weight;
+		}
+
+		totalWeight += weight;
+		frequency *= lacunarity;
+		weight *= gain;
+	}
+
+	for (int point = 0; point < numOfPoints; point++) {
+		result[point] = bRidged ? result[point] / totalWeight * 2.0f - 1.0f : result[point] / totalWeight;
+	}
+}
+
+FVoxelRegionMapsPtr FVoxelColumnGenerator::GetRegionMaps(const FIntPoint& chunkCoordinates, int width) const {
+	return regionMaps->FindOrBuild(FVoxelRegionMaps::GetRegion(chunkCoordinates), [&](FVoxelRegionMaps& maps) {
+		BuildRegionMaps(maps, width);
+	});
+}
+
+void FVoxelColumnGenerator::BuildRegionMaps(FVoxelRegionMaps& maps, int width) const {
+
+	// The region starts at the first column of its first chunk, which lies half a chunk below the chunk position.
+	maps.size = FVoxelRegionMaps::RegionChunks * width;
+	FIntPoint firstColumn = maps.region * maps.size - FIntPoint(width / 2, width / 2);
+	const int numOfColumns = maps.size * maps.size;
+
+	TArray<float> noise;
+	noise.SetNumUninitialized(numOfColumns);
+
+	// Sum up the noise patterns of the surface height.
+	float totalAmplitude = 0.0f;
+	maps.height.Init(0.0f, numOfColumns);
+	for (const FVoxelFractalNoise& pattern : heightNoise) {
+		pattern.Generate(*noiseContext, firstColumn, maps.size, noise.GetData());
+		for (int column = 0; column < numOfColumns; column++) {
+			maps.height[column] += pattern.amplitude * noise[column];
+		}
+		totalAmplitude += FMath::Abs(pattern.amplitude);
+	}
+
+	// Map the climate between 0 and 1, like the ranges of the biomes.
+	maps.heat.SetNumUninitialized(numOfColumns);
+	heatNoise.Generate(*noiseContext, firstColumn, maps.size, maps.heat.GetData());
+	maps.rainfall.SetNumUninitialized(numOfColumns);
+	rainfallNoise.Generate(*noiseContext, firstColumn, maps.size, maps.rainfall.GetData());
+	for (int column = 0; column < numOfColumns; column++) {
+		maps.heat[column] = maps.heat[column] * 0.5f + 0.5f;
+		maps.rainfall[column] = maps.rainfall[column] * 0.5f + 0.5f;
+	}
+
+	// Without biomes the noise is added to the base height.
+	if (biomes.Num() == 0) {
+		for (int column = 0; column < numOfColumns; column++) {
+			maps.height[column] += baseHeight;
+		}
+		return;
+	}
+
+	// Biomes spread the height noise between their own lowest and highest surface.
+	maps.biome.SetNumUninitialized(numOfColumns);
+	for (int column = 0; column < numOfColumns; column++) {
+		float relativeHeight = totalAmplitude > 0.0f ? maps.height[column] / totalAmplitude * 0.5f + 0.5f : 0.5f;
+		maps.height[column] = BlendBiomes(maps.heat[column], maps.rainfall[column], relativeHeight, maps.biome[column]);
+	}
+}
+
+void FVoxelColumnGenerator::BuildBiomeTable(const TArray<FVector2D>& heatRanges, const TArray<FVector2D>& rainfallRanges) {
+
+	biomeTable.Reset();
+	if (biomes.Num() == 0) return;
+	biomeTable.SetNumUninitialized(BiomeTableSize * BiomeTableSize);
+
+	for (int rainfallStep = 0; rainfallStep < BiomeTableSize; rainfallStep++) {
+	for (int heatStep = 0; heatStep < BiomeTableSize; heatStep++) {
+		float heat = (heatStep + 0.5f) / BiomeTableSize;
+		float rainfall = (rainfallStep + 0.5f) / BiomeTableSize;
+
+		// Prefer the most specific biome containing the climate, otherwise the biome with the closest ranges.
+		int bestBiome = 0;
+		float bestDistance = MAX_flt;
+		float bestArea = MAX_flt;
+		for (int biome = 0; biome < biomes.Num(); biome++) {
+			const FVector2D& heatRange = heatRanges[biome];
+			const FVector2D& rainfallRange = rainfallRanges[biome];
+			float heatDistance = FMath::Max3(heatRange.X - heat, heat - heatRange.Y, 0.0f);
+			float rainfallDistance = FMath::Max3(rainfallRange.X - rainfall, rainfall - rainfallRange.Y, 0.0f);
+			float distance = heatDistance * heatDistance + rainfallDistance * rainfallDistance;
+			float area = (heatRange.Y - heatRange.X) * (rainfallRange.Y - rainfallRange.X);
+
+			if (distance < bestDistance || (distance == bestDistance && area < bestArea)) {
+				bestBiome = biome;
+				bestDistance = distance;
+				bestArea = area;
+			}
+		}
+		biomeTable[heatStep + rainfallStep * BiomeTableSize] = (uint8)bestBiome;
+	}
+	}
+}
+
+float FVoxelColumnGenerator::BlendBiomes(float heat, float rainfall, float relativeHeight, uint8& biome) const {
+
+	// The table cells are centred on their climate, so the four closest cells surround the climate.
+	float u = FMath::Clamp(heat, 0.0f, 1.0f) * BiomeTableSize - 0.5f;
+	float v = FMath::Clamp(rainfall, 0.0f, 1.0f) * BiomeTableSize - 0.5f;
+	int u0 = FMath::FloorToInt(u);
+	int v0 = FMath::FloorToInt(v);
+	float fu = u - u0;
+	float fv = v - v0;
+
+	// Merge the weights of cells with the same biome.
+	uint8 cellBiomes[4];
+	float cellWeights[4];
+	int numOfBiomes = 0;
+	for (int corner = 0; corner < 4; corner++) {
+		int cellU = FMath::Clamp(u0 + (corner & 1), 0, BiomeTableSize - 1);
+		int cellV = FMath::Clamp(v0 + (corner >> 1), 0, BiomeTableSize - 1);
+		uint8 cellBiome = biomeTable[cellU + cellV * BiomeTableSize];
+		float weight = ((corner & 1) ? fu : 1.0f - fu) * ((corner >> 1) ? fv : 1.0f - fv);
+
+		int index = 0;
+		while (index < numOfBiomes && cellBiomes[index] != cellBiome) index++;
+		if (index == numOfBiomes) {
+			cellBiomes[numOfBiomes] = cellBiome;
+			cellWeights[numOfBiomes++] = 0.0f;
+		}
+		cellWeights[index] += weight;
+	}
+
+	// The surface height is blended, the layers come from the strongest biome.
+	float height = 0.0f;
+	int strongest = 0;
+	for (int index = 0; index < numOfBiomes; index++) {
+		const FVoxelBiome& cellBiome = biomes[cellBiomes[index]];
+		height += cellWeights[index] * FMath::Lerp(cellBiome.heightMin, cellBiome.heightMax, relativeHeight);
+		if (cellWeights[index] > cellWeights[strongest])
+			strongest = index;
+	}
+	biome = cellBiomes[strongest];
+	return height;
+}
+
+void FVoxelColumnGenerator::CalculateColumns(const FIntPoint& chunkCoordinates, int width, TArray<int>& columnKeys) const {
+
+	// Read the window of the chunk out of the maps of its region.
+	FVoxelRegionMapsPtr maps = GetRegionMaps(chunkCoordinates, width);
+	FIntPoint offset = (chunkCoordinates - maps->region * FVoxelRegionMaps::RegionChunks) * width;
+	bool bBiomes = maps->biome.Num() > 0;
+
+	columnKeys.SetNumUninitialized(width * width);
+	for (int y = 0; y < width; y++) {
+	for (int x = 0; x < width; x++) {
+		int index = offset.X + x + (offset.Y + y) * maps->size;
+		columnKeys[x + y * width] = MakeColumnKey(FMath::RoundToInt(maps->height[index]), bBiomes ? maps->biome[index] : 0);
+	}
+	}
+}
+
+void FVoxelColumnGenerator::CalculateDensity(const FIntPoint& chunkCoordinates, int width, int height, const TArray<int>& columnKeys, FVoxelDensityBand& band) const {
+
+	band = FVoxelDensityBand();
+	band.width = width;
+	if (!bDensity || columnKeys.Num() != width * width) return;
+	SCOPE_CYCLE_COUNTER(STAT_VoxelCalculateDensity);
+
+	// The density only reaches as far as its amplitude from the surface.
+	const float amplitude = FMath::Abs(densityNoise.amplitude);
+	const int reach = FMath::CeilToInt(amplitude);
+	TArray<int> surfaces;
+	surfaces.SetNumUninitialized(columnKeys.Num());
+	int minSurface = MAX_int32;
+	int maxSurface = MIN_int32;
+	for (int column = 0; column < columnKeys.Num(); column++) {
+		surfaces[column] = (int16)(columnKeys[column] & 0xffff);
+		minSurface = FMath::Min(minSurface, surfaces[column]);
+		maxSurface = FMath::Max(maxSurface, surfaces[column]);
+	}
+
+	band.zMin = FMath::Clamp(minSurface - reach, 0, height);
+	band.zMax = FMath::Clamp(maxSurface + reach + 1, 0, height);
+	if (band.zMin >= band.zMax) return;
+
+	// Sample the density noise on a coarse lattice, which starts at the first column of the chunk.
+	const int latticeZ = band.zMin - band.zMin % DensityStepZ;
+	const int sizeXY = (width + DensityStepXY - 1) / DensityStepXY + 1;
+	const int sizeZ = (band.zMax - 1 - latticeZ) / DensityStepZ + 2;
+	const FIntPoint firstColumn = chunkCoordinates * width - FIntPoint(width / 2, width / 2);
+
+	TArray<FVector> points;
+	points.Reserve(sizeXY * sizeXY * sizeZ);
+	for (int z = 0; z < sizeZ; z++) {
+	for (int y = 0; y < sizeXY; y++) {
+	for (int x = 0; x < sizeXY; x++) {
+		points.Add(FVector(firstColumn.X + x * DensityStepXY, firstColumn.Y + y * DensityStepXY, latticeZ + z * DensityStepZ));
+	}
+	}
+	}
+	TArray<float> lattice;
+	lattice.SetNumUninitialized(points.Num());
+	densityNoise.Generate3D(*noiseContext, points, lattice.GetData());
+
+	// Interpolate the density only where it can change the voxel. Higher voxels stay air, lower voxels stay solid.
+	band.solid.SetNumUninitialized(width * width * (band.zMax - band.zMin));
+	for (int y = 0; y < width; y++) {
+	for (int x = 0; x < width; x++) {
+		const int surface = surfaces[x + y * width];
+		const int lx = x / DensityStepXY;
+		const int ly = y / DensityStepXY;
+		const float fx = (float)(x % DensityStepXY) / DensityStepXY;
+		const float fy = (float)(y % DensityStepXY) / DensityStepXY;
+
+		for (int z = band.zMin; z < band.zMax; z++) {
+			uint8& solid = band.solid[x + y * width + (z - band.zMin) * width * width];
+			if (z > surface + reach) {
+				solid = 0;
+				continue;
+			}
+			if (z < surface - reach) {
+				solid = 1;
+				continue;
+			}
+
+			const int lz = (z - latticeZ) / DensityStepZ;
+			const float fz = (float)((z - latticeZ) % DensityStepZ) / DensityStepZ;
+			const float* cell = &lattice[lx + ly * sizeXY + lz * sizeXY * sizeXY];
+			const int stepY = sizeXY;
+			const int stepZ = sizeXY * sizeXY;
+
+			float bottom = FMath::Lerp(FMath::Lerp(cell[0], cell[1], fx), FMath::Lerp(cell[stepY], cell[stepY + 1], fx), fy);
+			float top = FMath::Lerp(FMath::Lerp(cell[stepZ], cell[stepZ + 1], fx), FMath::Lerp(cell[stepZ + stepY], cell[stepZ + stepY + 1], fx), fy);
+			float density = surface - z + amplitude * FMath::Lerp(bottom, top, fz);
+			solid = density >= 0.0f ? 1 : 0;
+		}
+	}
+	}
+}
+
+int FVoxelColumnGenerator::GetOverhangAssetID(int columnKey) const {
+
+	int biome = columnKey >> 16;
+	return biomes.IsValidIndex(biome) ? biomes[biome].fillAssetID : fillAssetID;
+}
+
+void FVoxelColumnGenerator::FillColumn(int columnKey, int height, int* column) const {
+
+	// Use the layers of the biome, if the world has biomes.
+	int surfaceHeight = (int16)(columnKey & 0xffff);
+	int biome = columnKey >> 16;
+	const TArray<FVoxelColumnLayer>& columnLayers = biomes.IsValidIndex(biome) ? biomes[biome].layers : layers;
+	const int columnFillAssetID = biomes.IsValidIndex(biome) ? biomes[biome].fillAssetID : fillAssetID;
+
+	// Air above the surface.
+	for (int z = height - 1; z > surfaceHeight && z >= 0; z--) {
+		column[z] = 0;
+	}
+
+	// The layers from the surface downwards.
+	int layerTop = surfaceHeight;
+	for (const FVoxelColumnLayer& layer : columnLayers) {
+		int layerBottom = layerTop - layer.thickness;
+		for (int z = FMath::Min(layerTop, height - 1); z > layerBottom && z >= 0; z--) {
+			column[z] = layer.assetID;
+		}
+		layerTop = layerBottom;
+	}
+
+	// The filling below the last layer.
+	for (int z = FMath::Min(layerTop, height - 1); z >= 0; z--) {
+		column[z] = columnFillAssetID;
+	}
+}
+
+// Compare the interpolated density with the density of every voxel, e.g. "voxel.BenchmarkDensity 64"
+static void BenchmarkDensity(const TArray<FString>& args) {
+
+	const int numOfChunks = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 1) : 64;
+	const int width = 16;
+	const int height = 128;
+	const int numOfVoxels = width * width * height;
+
+	FVoxelColumnGenerator generator;
+	generator.heightNoise.AddDefaulted();
+	generator.bDensity = true;
+	generator.densityNoise.scale = 0.03f;
+	generator.densityNoise.amplitude = 12.0f;
+	generator.densityNoise.octaves = 2;
+
+	// The region maps are built before the measurement, so both paths only calculate the density.
+	TArray<TArray<int>> columnKeys;
+	for (int chunk = 0; chunk < numOfChunks; chunk++) {
+		generator.CalculateColumns(FIntPoint(chunk, 0), width, columnKeys.AddDefaulted_GetRef());
+	}
+
+	// Every voxel of the chunk samples the noise.
+	TArray<FVector> points;
+	TArray<float> noise;
+	points.SetNumUninitialized(numOfVoxels);
+	noise.SetNumUninitialized(numOfVoxels);
+	TArray<TArray<uint8>> fullSolid;
+	double start = FPlatformTime::Seconds();
+	for (int chunk = 0; chunk < numOfChunks; chunk++) {
+		FIntPoint firstColumn = FIntPoint(chunk, 0) * width - FIntPoint(width / 2, width / 2);
+		for (int index = 0; index < numOfVoxels; index++) {
+			points[index] = FVector(firstColumn.X + index % width, firstColumn.Y + index / width % width, index / (width * width));
+		}
+		generator.densityNoise.Generate3D(*generator.noiseContext, points, noise.GetData());
+
+		TArray<uint8>& solid = fullSolid.AddDefaulted_GetRef();
+		solid.SetNumUninitialized(numOfVoxels);
+		for (int index = 0; index < numOfVoxels; index++) {
+			int surface = (int16)(columnKeys[chunk][index % (width * width)] & 0xffff);
+			solid[index] = surface - index / (width * width) + generator.densityNoise.amplitude * noise[index] >= 0.0f ? 1 : 0;
+		}
+	}
+	double fullTime = FPlatformTime::Seconds() - start;
+
+	// The coarse lattice only covers the band around the surface.
+	TArray<FVoxelDensityBand> bands;
+	start = FPlatformTime::Seconds();
+	for (int chunk = 0; chunk < numOfChunks; chunk++) {
+		generator.CalculateDensity(FIntPoint(chunk, 0), width, height, columnKeys[chunk], bands.AddDefaulted_GetRef());
+	}
+	double interpolatedTime = FPlatformTime::Seconds() - start;
+
+	// Count the voxels both paths agree on.
+	int64 matching = 0;
+	for (int chunk = 0; chunk < numOfChunks; chunk++) {
+		for (int index = 0; index < numOfVoxels; index++) {
+			int z = index / (width * width);
+			int surface = (int16)(columnKeys[chunk][index % (width * width)] & 0xffff);
+			bool bSolid = bands[chunk].Contains(z) ? bands[chunk].IsSolid(index % width, index / width % width, z) : z <= surface;
+			matching += bSolid == (fullSolid[chunk][index] != 0) ? 1 : 0;
+		}
+	}
+
+	const double totalVoxels = (double)numOfChunks * numOfVoxels;
+	UE_LOG(LogTemp, Display, TEXT("Density: %d chunks, full %.1f Mvoxels/s, interpolated %.1f Mvoxels/s, %.2f%% matching voxels"),
+		numOfChunks, totalVoxels / fullTime / 1e6, totalVoxels / interpolatedTime / 1e6, matching / totalVoxels * 100.0);
+}
+
+static FAutoConsoleCommand BenchmarkDensityCommand(
+	TEXT("voxel.BenchmarkDensity"),
+	TEXT("Measures the voxels per second of the full and the interpolated 3D density and logs how many voxels match. Takes the number of chunks."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkDensity));
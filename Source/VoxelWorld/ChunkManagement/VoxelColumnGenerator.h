@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "../Libraries/SimplexNoiseContext.h"
+#include "VoxelRegionMaps.h"
+
+// A layer of the same voxel asset below the surface.
+struct FVoxelColumnLayer {
+
+	// The asset ID of the layer. Zero means air.
+	int assetID = 0;
+
+	// The thickness of the layer in voxels.
+	int thickness = 1;
+};
+
+// A noise pattern summed up from several octaves of simplex noise.
+struct FVoxelFractalNoise {
+
+	// The frequency of the first octave per voxel.
+	float scale = 0.01f;
+
+	// The maximum height variation in voxels. Only used for the surface height.
+	float amplitude = 8.0f;
+
+	// The number of octaves.
+	int octaves = 1;
+
+	// The frequency of every octave compared to the previous one.
+	float lacunarity = 2.0f;
+
+	// The weight of every octave compared to the previous one.
+	float gain = 0.5f;
+
+	// Sum up ridges (one minus the absolute noise, squared) instead of the noise itself (fBm).
+	bool bRidged = false;
+
+	// Evaluate the noise for a square of columns. Every octave is evaluated for all columns in one batch.
+	// @param context - The noise of the world seed.
+	// @param firstColumn - The world voxel position of the first column.
+	// @param size - The number of columns along a side of the square.
+	// @param result - The noise between -1 and 1 of every column, indexed by X plus Y times the size.
+	// @return - VOID
+	void Generate(const FSimplexNoiseContext& context, const FIntPoint& firstColumn, int size, float* result) const;
+
+	// Evaluate the 3D noise for a list of points. Every octave is evaluated for all points in one batch.
+	// @param context - The noise of the world seed.
+	// @param points - The world voxel positions of the points.
+	// @param result - The noise between -1 and 1 of every point.
+	// @return - VOID
+	void Generate3D(const FSimplexNoiseContext& context, const TArray<FVector>& points, float* result) const;
+};
+
+// The solid voxels of a chunk between two heights, calculated from the 3D density.
+struct FVoxelDensityBand {
+
+	// The lowest Z position inside the band.
+	int zMin = 0;
+
+	// The first Z position above the band.
+	int zMax = 0;
+
+	// The width of the chunk in voxels.
+	int width = 0;
+
+	// Is the voxel solid, indexed by X plus Y times the width plus the Z above the band bottom times the width squared.
+	TArray<uint8> solid;
+
+	// Check, if the band covers the given height.
+	FORCEINLINE bool Contains(int z) const {
+		return z >= zMin && z < zMax;
+	}
+
+	// Check, if the band covers any height between zStart (included) and zEnd (excluded).
+	FORCEINLINE bool Overlaps(int zStart, int zEnd) const {
+		return zStart < zMax && zEnd > zMin;
+	}
+
+	// Check, if a voxel inside the band is solid.
+	FORCEINLINE bool IsSolid(int x, int y, int z) const {
+		return solid[x + y * width + (z - zMin) * width * width] != 0;
+	}
+};
+
+// The surface and layers of a biome.
+struct FVoxelBiome {
+
+	// The lowest surface height of the biome in voxels.
+	float heightMin = 0.0f;
+
+	// The highest surface height of the biome in voxels.
+	float heightMax = 0.0f;
+
+	// The layers from the surface downwards.
+	TArray<FVoxelColumnLayer> layers;
+
+	// The asset ID of every voxel below the last layer.
+	int fillAssetID = 0;
+};
+
+/* Fills whole voxel columns from a surface height and a table of layers. Only holds plain values resolved from a generator
+   asset, so it can be used on any thread without touching UObjects. Immutable after its creation, apart from the cache of
+   region maps, which is thread safe. */
+class VOXELWORLD_API FVoxelColumnGenerator {
+
+public:
+	// The surface height in voxels without any noise.
+	int baseHeight = 30;
+
+	// The noise patterns added to the surface height.
+	TArray<FVoxelFractalNoise> heightNoise;
+
+	// The noise of the heat map.
+	FVoxelFractalNoise heatNoise;
+
+	// The noise of the rainfall map.
+	FVoxelFractalNoise rainfallNoise;
+
+	// The layers from the surface downwards. The first layer starts at the surface voxel.
+	TArray<FVoxelColumnLayer> layers;
+
+	// The asset ID of every voxel below the last layer.
+	int fillAssetID = 0;
+
+	// The biomes of the world. Without biomes the surface height and the layers of the generator are used.
+	TArray<FVoxelBiome> biomes;
+
+	// The number of heat and rainfall steps of the biome table.
+	static constexpr int BiomeTableSize = 32;
+
+	// The biome of every quantised heat and rainfall, indexed by heat plus rainfall times the table size.
+	TArray<uint8> biomeTable;
+
+	// Is the surface shaped by the 3D density, which adds overhangs and caves?
+	bool bDensity = false;
+
+	// The 3D noise of the density. Its amplitude is the number of voxels it can move the surface up or down.
+	FVoxelFractalNoise densityNoise;
+
+	// The horizontal distance between two density samples in voxels.
+	static constexpr int DensityStepXY = 4;
+
+	// The vertical distance between two density samples in voxels.
+	static constexpr int DensityStepZ = 8;
+
+	// The noise of the world seed. Shared with every generator of the same seed.
+	const FSimplexNoiseContext* noiseContext = &FSimplexNoiseContext::GetDefault();
+
+	// The maps of the recently generated regions. The chunks of a world share their width, so the maps fit every chunk.
+	TSharedRef<FVoxelRegionMapCache, ESPMode::ThreadSafe> regionMaps = MakeShared<FVoxelRegionMapCache, ESPMode::ThreadSafe>(9);
+
+	// Find the maps of the region around a chunk or build them.
+	// @param chunkCoordinates - The X and Y index of the chunk.
+	// @param width - The width of the chunks in voxels.
+	// @return - The maps of the region.
+	FVoxelRegionMapsPtr GetRegionMaps(const FIntPoint& chunkCoordinates, int width) const;
+
+	// Assign the biome with the best matching climate to every cell of the biome table.
+	// Has to be called after the biomes are set.
+	// @param heatRanges - The lowest and highest heat of every biome.
+	// @param rainfallRanges - The lowest and highest rainfall of every biome.
+	// @return - VOID
+	void BuildBiomeTable(const TArray<FVector2D>& heatRanges, const TArray<FVector2D>& rainfallRanges);
+
+	// Calculate the key of every column of a chunk from the maps of its region.
+	// Columns with the same key are filled with the same voxels.
+	// @param chunkCoordinates - The X and Y index of the chunk.
+	// @param width - The width of the chunk in voxels.
+	// @param columnKeys - The key of every column, indexed by X plus Y times the width.
+	// @return - VOID
+	void CalculateColumns(const FIntPoint& chunkCoordinates, int width, TArray<int>& columnKeys) const;
+
+	// Fill the asset IDs of a whole column.
+	// @param columnKey - The surface height and biome of the column.
+	// @param height - The height of the chunk in voxels.
+	// @param column - The asset ID of every voxel of the column, indexed by Z.
+	// @return - VOID
+	void FillColumn(int columnKey, int height, int* column) const;
+
+	// Calculate the solid voxels around the surface of a chunk from the 3D density.
+	// The density is sampled on a coarse lattice and interpolated trilinearly. Voxels, which the density can't reach
+	// from the surface, are solid below and air above the band without being evaluated.
+	// @param chunkCoordinates - The X and Y index of the chunk.
+	// @param width - The width of the chunk in voxels.
+	// @param height - The height of the chunk in voxels.
+	// @param columnKeys - The key of every column, indexed by X plus Y times the width.
+	// @param band - The solid voxels. Empty, if the density is disabled.
+	// @return - VOID
+	void CalculateDensity(const FIntPoint& chunkCoordinates, int width, int height, const TArray<int>& columnKeys, FVoxelDensityBand& band) const;
+
+	// The asset ID of solid voxels the density adds above the surface.
+	// @param columnKey - The surface height and biome of the column.
+	// @return - The asset ID.
+	int GetOverhangAssetID(int columnKey) const;
+
+	// Combine the surface height and biome of a column into a key.
+	// @param surfaceHeight - The Z position of the surface voxel. Clamped to 16 bits.
+	// @param biome - The index of the biome.
+	// @return - The key of the column.
+	static FORCEINLINE int MakeColumnKey(int surfaceHeight, int biome) {
+		return (biome << 16) | (FMath::Clamp(surfaceHeight, -32768, 32767) & 0xffff);
+	}
+
+private:
+	// Calculate the height and climate maps of a whole region.
+	// @param maps - The maps to fill. Their region is already set.
+	// @param width - The width of the chunks in voxels.
+	// @return - VOID
+	void BuildRegionMaps(FVoxelRegionMaps& maps, int width) const;
+
+	// Blend the surface height of the biomes around a climate.
+	// The four closest cells of the biome table are weighted bilinearly, so the height changes smoothly at biome borders.
+	// @param heat - The heat between 0 and 1.
+	// @param rainfall - The rainfall between 0 and 1.
+	// @param relativeHeight - The height noise between 0 and 1.
+	// @param biome - The biome with the highest weight.
+	// @return - The surface height in voxels.
+	float BlendBiomes(float heat, float rainfall, float relativeHeight, uint8& biome) const;
+};
+
+typedef TSharedPtr<const FVoxelColumnGenerator, ESPMode::ThreadSafe> FVoxelColumnGeneratorPtr;
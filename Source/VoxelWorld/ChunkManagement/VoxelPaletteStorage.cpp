@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelPaletteStorage.h"
+
+void FVoxelPaletteStorage::Init(int _numOfVoxels, int value) {
+
+	numOfVoxels = _numOfVoxels;
+	bitsShift = 0;
+	indexMask = 1;
+
+	// Every voxel points to the only palette entry.
+	palette.Reset();
+	paletteLookup.Reset();
+	palette.Add(value);
+	paletteLookup.Add(value, 0);
+	lastValue = value;
+	lastPaletteIndex = 0;
+
+	words.Empty();
+}
+
+void FVoxelPaletteStorage::Set(int index, int value) {
+
+	// Expand uniform storages on the first differing write.
+	if (IsUniform()) {
+		if (value == palette[0]) return;
+		words.SetNumZeroed(FMath::DivideAndRoundUp(numOfVoxels << bitsShift, 64));
+	}
+
+	int paletteIndex = value == lastValue ? lastPaletteIndex : FindOrAddPaletteIndex(value);
+	lastValue = value;
+	lastPaletteIndex = paletteIndex;
+	SetPaletteIndex(index, paletteIndex);
+}
+
+void FVoxelPaletteStorage::CopyTo(TArray<int>& voxels) const {
+
+	voxels.SetNumUninitialized(numOfVoxels);
+	CopyTo(voxels.GetData());
+}
+
+void FVoxelPaletteStorage::CopyTo(int* voxels) const {
+
+	int* target = voxels;
+	if (IsUniform()) {
+		for (int i = 0; i < numOfVoxels; i++) {
+			target[i] = palette[0];
+		}
+		return;
+	}
+
+	const int* paletteData = palette.GetData();
+	const int bitsPerVoxel = GetBitsPerVoxel();
+	const int voxelsPerWord = 64 >> bitsShift;
+
+	// Decode whole words at once.
+	for (int w = 0; w < words.Num(); w++) {
+		uint64 word = words[w];
+		int count = FMath::Min(voxelsPerWord, numOfVoxels - w * voxelsPerWord);
+		for (int i = 0; i < count; i++) {
+			target[i] = paletteData[word & indexMask];
+			word >>= bitsPerVoxel;
+		}
+		target += count;
+	}
+}
+
+void FVoxelPaletteStorage::CopyFrom(const TArray<int>& voxels) {
+
+	// Collect the used asset IDs first, so the index width is chosen once.
+	Init(voxels.Num(), voxels.Num() > 0 ? voxels[0] : 0);
+	for (int value : voxels) {
+		if (IsUniform() && value != palette[0])
+			words.SetNumZeroed(FMath::DivideAndRoundUp(numOfVoxels, 64));
+
+		if (value != lastValue) {
+			lastValue = value;
+			lastPaletteIndex = FindOrAddPaletteIndex(value);
+		}
+	}
+
+	for (int i = 0; i < voxels.Num(); i++) {
+		Set(i, voxels[i]);
+	}
+}
+
+SIZE_T FVoxelPaletteStorage::GetAllocatedSize() const {
+	return palette.GetAllocatedSize() + paletteLookup.GetAllocatedSize() + words.GetAllocatedSize();
+}
+
+int FVoxelPaletteStorage::FindOrAddPaletteIndex(int value) {
+
+	if (const int* paletteIndex = paletteLookup.Find(value))
+		return *paletteIndex;
+
+	// The palette can hold at most 16 bit indices.
+	check(palette.Num() < 65536);
+
+	int paletteIndex = palette.Add(value);
+	paletteLookup.Add(value, paletteIndex);
+	if (paletteIndex > indexMask)
+		GrowIndexWidth();
+	return paletteIndex;
+}
+
+void FVoxelPaletteStorage::GrowIndexWidth() {
+
+	// Decode the current indices before the layout changes.
+	const int oldBitsShift = bitsShift;
+	const int oldIndexMask = indexMask;
+	const TArray<uint64> oldWords = MoveTemp(words);
+
+	while ((1 << (1 << bitsShift)) < palette.Num())
+		bitsShift++;
+	indexMask = (1 << (1 << bitsShift)) - 1;
+
+	words.SetNumZeroed(FMath::DivideAndRoundUp(numOfVoxels << bitsShift, 64));
+
+	// Every voxel of a uniform storage uses the first palette entry, which is already set.
+	if (oldWords.Num() == 0) return;
+
+	for (int i = 0; i < numOfVoxels; i++) {
+		int bitIndex = i << oldBitsShift;
+		int paletteIndex = (oldWords[bitIndex >> 6] >> (bitIndex & 63)) & oldIndexMask;
+		SetPaletteIndex(i, paletteIndex);
+	}
+}
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Stores voxel asset IDs as indices into a palette of the distinct IDs, packed into 1, 2, 4, 8 or 16 bits per voxel.
+   The index width grows automatically, whenever the palette outgrows it. Uniform storages keep only the single value until the first differing write. */
+class VOXELWORLD_API FVoxelPaletteStorage {
+
+public:
+	// Resize the storage and fill every voxel with the same asset ID. The storage is uniform afterwards.
+	// @param _numOfVoxels - The number of voxels.
+	// @param value - The asset ID of every voxel.
+	// @return - VOID
+	void Init(int _numOfVoxels, int value = 0);
+
+	// The number of stored voxels.
+	FORCEINLINE int Num() const {
+		return numOfVoxels;
+	}
+
+	// Check, if the given index is inside the storage.
+	FORCEINLINE bool IsValidIndex(int index) const {
+		return index >= 0 && index < numOfVoxels;
+	}
+
+	// Receive the asset ID of a single voxel.
+	// @param index - The index of the voxel.
+	// @return - The asset ID.
+	FORCEINLINE int Get(int index) const {
+		if (IsUniform()) return palette[0];
+		int bitIndex = index << bitsShift;
+		return palette[(words[bitIndex >> 6] >> (bitIndex & 63)) & indexMask];
+	}
+
+	// Replace the asset ID of a single voxel. New asset IDs are added to the palette.
+	// @param index - The index of the voxel.
+	// @param value - The new asset ID.
+	// @return - VOID
+	void Set(int index, int value);
+
+	// Decode every voxel into a plain array.
+	// @param voxels - The asset ID of every voxel.
+	// @return - VOID
+	void CopyTo(TArray<int>& voxels) const;
+
+	// Decode every voxel into the given memory.
+	// @param voxels - The memory for the asset ID of every voxel.
+	// @return - VOID
+	void CopyTo(int* voxels) const;
+
+	// Check, if every voxel has the same asset ID and no indices are stored.
+	FORCEINLINE bool IsUniform() const {
+		return words.Num() == 0;
+	}
+
+	// Replace every voxel and rebuild the palette from the used asset IDs only.
+	// @param voxels - The asset ID of every voxel.
+	// @return - VOID
+	void CopyFrom(const TArray<int>& voxels);
+
+	// The number of bits used for a single voxel.
+	FORCEINLINE int GetBitsPerVoxel() const {
+		return 1 << bitsShift;
+	}
+
+	// The number of distinct asset IDs inside the palette.
+	FORCEINLINE int GetNumOfPaletteEntries() const {
+		return palette.Num();
+	}
+
+	// The memory used by the storage in bytes.
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// Find the palette index of an asset ID or add it to the palette.
+	int FindOrAddPaletteIndex(int value);
+
+	// Repack every voxel with twice the bits, until the palette fits.
+	void GrowIndexWidth();
+
+	// Write a palette index into the packed words.
+	FORCEINLINE void SetPaletteIndex(int index, int paletteIndex) {
+		int bitIndex = index << bitsShift;
+		uint64& word = words[bitIndex >> 6];
+		int shift = bitIndex & 63;
+		word = (word & ~((uint64)indexMask << shift)) | ((uint64)paletteIndex << shift);
+	}
+
+	// The distinct asset IDs.
+	TArray<int> palette;
+
+	// The palette index of every asset ID inside the palette.
+	TMap<int, int> paletteLookup;
+
+	// The packed palette indices of every voxel.
+	TArray<uint64> words;
+
+	// The number of stored voxels.
+	int numOfVoxels = 0;
+
+	// The binary logarithm of the bits per voxel. Zero to four for 1, 2, 4, 8 and 16 bits.
+	int bitsShift = 0;
+
+	// The mask of a single palette index.
+	int indexMask = 1;
+
+	// The asset ID and palette index of the latest write. Speeds up writing runs of the same asset.
+	int lastValue = 0;
+	int lastPaletteIndex = 0;
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelRegionMaps.h"
+#include "Misc/ScopeLock.h"
+#include "../VoxelWorld.h"
+
+DECLARE_CYCLE_STAT(TEXT("Build Region Maps"), STAT_VoxelBuildRegionMaps, STATGROUP_VoxelWorld);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cached Regions"), STAT_VoxelCachedRegions, STATGROUP_VoxelWorld);
+
+FVoxelRegionMapCache::FVoxelRegionMapCache(int _capacity) {
+	capacity = FMath::Max(_capacity, 1);
+}
+
+FVoxelRegionMapsPtr FVoxelRegionMapCache::FindOrBuild(const FIntPoint& region, TFunctionRef<void(FVoxelRegionMaps&)> build) {
+
+	TSharedPtr<FEntry, ESPMode::ThreadSafe> entry;
+	{
+		FScopeLock scopeLock(&lock);
+		TSharedPtr<FEntry, ESPMode::ThreadSafe>* found = entries.Find(region);
+		if (found) {
+			entry = *found;
+		}
+		else {
+
+			// Drop the least recently used region. Threads still sampling it keep their maps alive.
+			if (entries.Num() >= capacity) {
+				FIntPoint oldest = region;
+				uint64 oldestUse = MAX_uint64;
+				for (const TPair<FIntPoint, TSharedPtr<FEntry, ESPMode::ThreadSafe>>& pair : entries) {
+					if (pair.Value->lastUse < oldestUse) {
+						oldest = pair.Key;
+						oldestUse = pair.Value->lastUse;
+					}
+				}
+				entries.Remove(oldest);
+			}
+
+			entry = MakeShared<FEntry, ESPMode::ThreadSafe>();
+			entries.Add(region, entry);
+			SET_DWORD_STAT(STAT_VoxelCachedRegions, entries.Num());
+		}
+		entry->lastUse = ++useCounter;
+	}
+
+	// Threads requesting the same region wait here until the first one finished building it.
+	FScopeLock scopeLock(&entry->buildLock);
+	if (!entry->maps) {
+		SCOPE_CYCLE_COUNTER(STAT_VoxelBuildRegionMaps);
+
+		TSharedPtr<FVoxelRegionMaps, ESPMode::ThreadSafe> maps = MakeShared<FVoxelRegionMaps, ESPMode::ThreadSafe>();
+		maps->region = region;
+		build(*maps);
+		entry->maps = maps;
+	}
+	return entry->maps;
+}
+
+void FVoxelRegionMapCache::Empty() {
+
+	FScopeLock scopeLock(&lock);
+	entries.Empty();
+	SET_DWORD_STAT(STAT_VoxelCachedRegions, 0);
+}
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+// The surface height and climate of every column inside a square region of chunks.
+struct FVoxelRegionMaps {
+
+	// The number of chunks along a side of a region.
+	static constexpr int RegionChunks = 16;
+
+	// The X and Y index of the region.
+	FIntPoint region = FIntPoint(0, 0);
+
+	// The number of columns along a side of the maps.
+	int size = 0;
+
+	// The surface height of every column, indexed by X plus Y times the size.
+	TArray<float> height;
+
+	// The heat of every column between 0 and 1.
+	TArray<float> heat;
+
+	// The rainfall of every column between 0 and 1.
+	TArray<float> rainfall;
+
+	// The biome of every column. Empty, if the world has no biomes.
+	TArray<uint8> biome;
+
+	// Calculate the region of a chunk.
+	// @param chunkCoordinates - The X and Y index of the chunk.
+	// @return - The X and Y index of the region.
+	static FIntPoint GetRegion(const FIntPoint& chunkCoordinates) {
+		return FIntPoint(
+			chunkCoordinates.X >= 0 ? chunkCoordinates.X / RegionChunks : (chunkCoordinates.X - RegionChunks + 1) / RegionChunks,
+			chunkCoordinates.Y >= 0 ? chunkCoordinates.Y / RegionChunks : (chunkCoordinates.Y - RegionChunks + 1) / RegionChunks
+		);
+	}
+};
+
+typedef TSharedPtr<const FVoxelRegionMaps, ESPMode::ThreadSafe> FVoxelRegionMapsPtr;
+
+/* Keeps the maps of the most recently used regions, so the chunks of a region only sample them instead of calculating
+   the noise again. Thread safe: a region requested by several threads at once is built by the first one, while the
+   others wait for it. Regions are built outside of the cache lock, so different regions are built in parallel. */
+class VOXELWORLD_API FVoxelRegionMapCache {
+
+public:
+	// @param _capacity - The number of regions kept before the least recently used one is dropped.
+	explicit FVoxelRegionMapCache(int _capacity);
+
+	// Find the maps of a region or build them, if they aren't cached.
+	// @param region - The X and Y index of the region.
+	// @param build - Fills the maps of a missing region. Called without holding the cache lock.
+	// @return - The maps of the region. Stay valid after they are dropped from the cache.
+	FVoxelRegionMapsPtr FindOrBuild(const FIntPoint& region, TFunctionRef<void(FVoxelRegionMaps&)> build);
+
+	// Drop every cached region.
+	// @return - VOID
+	void Empty();
+
+private:
+	struct FEntry {
+
+		// The finished maps. Empty, while the region is built.
+		FVoxelRegionMapsPtr maps;
+
+		// Held while the region is built.
+		FCriticalSection buildLock;
+
+		// The use counter of the last request.
+		uint64 lastUse = 0;
+	};
+
+	// The cached regions.
+	TMap<FIntPoint, TSharedPtr<FEntry, ESPMode::ThreadSafe>> entries;
+
+	// Guards the entries and the use counter.
+	FCriticalSection lock;
+
+	// Counts the requests to find the least recently used region.
+	uint64 useCounter = 0;
+
+	// The number of regions kept.
+	int capacity = 1;
+};
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelSectionStorage.h"
+#include "../VoxelWorld.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Decode Voxels (Linear)"), STAT_VoxelDecodeLinear, STATGROUP_VoxelWorld);
+DECLARE_CYCLE_STAT(TEXT("Decode Voxels (Bricks)"), STAT_VoxelDecodeBricks, STATGROUP_VoxelWorld);
+
+static TAutoConsoleVariable<int32> CVarVoxelLayout(
+	TEXT("voxel.VoxelLayout"),
+	0,
+	TEXT("The order of the voxels inside newly initialized chunks. 0: Linear, 1: 4x4x4 bricks in Z-order. Compare both with \"stat VoxelWorld\"."),
+	ECVF_Default);
+
+void FVoxelSectionStorage::Init(int _width, int _height, int _sectionHeight, EVoxelLayout layoutType, int value) {
+
+	width = _width;
+	sectionHeight = FMath::Max(_sectionHeight, 1);
+	sectionSize = width * width * sectionHeight;
+	numOfVoxels = width * width * _height;
+
+	// Bricks need every section to consist of whole bricks.
+	if (width % 4 != 0 || sectionHeight % 4 != 0 || _height % sectionHeight != 0)
+		layoutType = EVoxelLayout::Linear;
+
+	layout.type = layoutType;
+	layout.width = width;
+	layout.widthSquared = width * width;
+	layout.bricksPerRow = width / 4;
+	layout.bricksPerLayer = layout.bricksPerRow * layout.bricksPerRow;
+
+	// The last section may be smaller than the others.
+	sections.SetNum(FMath::DivideAndRoundUp(numOfVoxels, sectionSize));
+	for (int s = 0; s < sections.Num(); s++) {
+		sections[s] = MakeShared<FVoxelPaletteStorage, ESPMode::ThreadSafe>();
+		sections[s]->Init(FMath::Min(sectionSize, numOfVoxels - s * sectionSize), value);
+	}
+}
+
+EVoxelLayout FVoxelSectionStorage::GetDefaultLayout() {
+	return CVarVoxelLayout.GetValueOnAnyThread() == 1 ? EVoxelLayout::Bricks : EVoxelLayout::Linear;
+}
+
+void FVoxelSectionStorage::SetSection(int section, int value) {
+	// Replace the section instead of writing into it, because copies may still read it.
+	int numOfSectionVoxels = sections[section]->Num();
+	sections[section] = MakeShared<FVoxelPaletteStorage, ESPMode::ThreadSafe>();
+	sections[section]->Init(numOfSectionVoxels, value);
+}
+
+void FVoxelSectionStorage::CopyTo(TArray<int>& voxels) const {
+
+	voxels.SetNumUninitialized(numOfVoxels);
+
+	// The linear layout already matches the voxel index.
+	if (layout.type == EVoxelLayout::Linear) {
+		SCOPE_CYCLE_COUNTER(STAT_VoxelDecodeLinear);
+		for (int s = 0; s < sections.Num(); s++) {
+			sections[s]->CopyTo(voxels.GetData() + s * sectionSize);
+		}
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_VoxelDecodeBricks);
+	TArray<int, TInlineAllocator<4096>> sectionVoxels;
+	sectionVoxels.SetNumUninitialized(sectionSize);
+
+	for (int s = 0; s < sections.Num(); s++) {
+
+		// Uniform sections don't need to be reordered.
+		int* target = voxels.GetData() + s * sectionSize;
+		if (sections[s]->IsUniform()) {
+			sections[s]->CopyTo(target);
+			continue;
+		}
+
+		sections[s]->CopyTo(sectionVoxels.GetData());
+		for (int z = 0; z < sectionHeight; z++) {
+		for (int y = 0; y < width; y++) {
+		for (int x = 0; x < width; x++) {
+			*target++ = sectionVoxels[layout.GetIndex(x, y, z)];
+		}
+		}
+		}
+	}
+}
+
+SIZE_T FVoxelSectionStorage::GetAllocatedSize() const {
+
+	SIZE_T allocatedSize = sections.GetAllocatedSize();
+	for (const TSharedPtr<FVoxelPaletteStorage, ESPMode::ThreadSafe>& section : sections) {
+		allocatedSize += sizeof(FVoxelPaletteStorage) + section->GetAllocatedSize();
+	}
+	return allocatedSize;
+}
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelPaletteStorage.h"
+
+// The order of the voxels inside a section.
+enum class EVoxelLayout : uint8 {
+
+	// X first, then Y, then Z. The same order as the voxel index.
+	Linear,
+
+	// 4x4x4 bricks in linear order with the voxels of every brick in Z-order. Neighbours in every direction stay close in memory.
+	Bricks
+};
+
+/* Maps the position of a voxel inside a section to its storage index. */
+struct FVoxelLayout {
+
+	EVoxelLayout type = EVoxelLayout::Linear;
+	int width = 16;
+	int widthSquared = 256;
+	int bricksPerRow = 4;
+	int bricksPerLayer = 16;
+
+	// Calculate the storage index of a voxel inside a section.
+	// @param x - The X position.
+	// @param y - The Y position.
+	// @param z - The Z position relative to the section.
+	// @return - The storage index.
+	FORCEINLINE int GetIndex(int x, int y, int z) const {
+		if (type == EVoxelLayout::Linear)
+			return x + y * width + z * widthSquared;
+
+		// Interleave the lower two bits of every axis inside the brick.
+		int brick = (x >> 2) + (y >> 2) * bricksPerRow + (z >> 2) * bricksPerLayer;
+		int local = (x & 1) | ((y & 1) << 1) | ((z & 1) << 2) | ((x & 2) << 2) | ((y & 2) << 3) | ((z & 2) << 4);
+		return (brick << 6) | local;
+	}
+};
+
+/* Stores the voxels of a chunk in vertical sections of palette storages. Sections with a single asset ID, like air
+   above the surface or stone deep below, only store that value until they are edited.
+   Copies share their sections. A shared section is copied on the first write, so copies are cheap, stable snapshots
+   that can be read on other threads. */
+class VOXELWORLD_API FVoxelSectionStorage {
+
+public:
+	// Resize the storage and fill every section with the same asset ID.
+	// @param _width - The width of the chunk in voxels.
+	// @param _height - The height of the chunk in voxels.
+	// @param _sectionHeight - The height of a single section in voxels.
+	// @param layoutType - The order of the voxels inside a section. Falls back to the linear layout, if the sizes don't fit.
+	// @param value - The asset ID of every voxel.
+	// @return - VOID
+	void Init(int _width, int _height, int _sectionHeight, EVoxelLayout layoutType, int value = 0);
+
+	// The layout selected with "voxel.VoxelLayout".
+	static EVoxelLayout GetDefaultLayout();
+
+	// The number of stored voxels.
+	FORCEINLINE int Num() const {
+		return numOfVoxels;
+	}
+
+	// Check, if the given index is inside the storage.
+	FORCEINLINE bool IsValidIndex(int index) const {
+		return index >= 0 && index < numOfVoxels;
+	}
+
+	// The order of the voxels inside a section.
+	FORCEINLINE EVoxelLayout GetLayout() const {
+		return layout.type;
+	}
+
+	// Receive the asset ID of a single voxel.
+	// @param x - The X position.
+	// @param y - The Y position.
+	// @param z - The Z position.
+	// @return - The asset ID.
+	FORCEINLINE int Get(int x, int y, int z) const {
+		return sections[z / sectionHeight]->Get(layout.GetIndex(x, y, z % sectionHeight));
+	}
+
+	// Receive the asset ID of a single voxel.
+	// @param index - The voxel index (X + Y * width + Z * width squared).
+	// @return - The asset ID.
+	FORCEINLINE int Get(int index) const {
+		if (layout.type == EVoxelLayout::Linear)
+			return sections[index / sectionSize]->Get(index % sectionSize);
+		return Get(index % width, (index / width) % width, index / layout.widthSquared);
+	}
+
+	// Replace the asset ID of a single voxel. Uniform sections are expanded on the first differing write.
+	// @param x - The X position.
+	// @param y - The Y position.
+	// @param z - The Z position.
+	// @param value - The new asset ID.
+	// @return - VOID
+	FORCEINLINE void Set(int x, int y, int z, int value) {
+		GetMutableSection(z / sectionHeight).Set(layout.GetIndex(x, y, z % sectionHeight), value);
+	}
+
+	// Replace the asset ID of a single voxel. Uniform sections are expanded on the first differing write.
+	// @param index - The voxel index (X + Y * width + Z * width squared).
+	// @param value - The new asset ID.
+	// @return - VOID
+	FORCEINLINE void Set(int index, int value) {
+		if (layout.type == EVoxelLayout::Linear)
+			GetMutableSection(index / sectionSize).Set(index % sectionSize, value);
+		else
+			Set(index % width, (index / width) % width, index / layout.widthSquared, value);
+	}
+
+	// Fill a whole section with a single asset ID without storing any indices.
+	// @param section - The index of the section.
+	// @param value - The asset ID of every voxel inside the section.
+	// @return - VOID
+	void SetSection(int section, int value);
+
+	// The number of sections.
+	FORCEINLINE int GetNumOfSections() const {
+		return sections.Num();
+	}
+
+	// Check, if every voxel of a section has the same asset ID.
+	FORCEINLINE bool IsSectionUniform(int section) const {
+		return sections[section]->IsUniform();
+	}
+
+	// Decode every voxel into a plain array in voxel index order.
+	// @param voxels - The asset ID of every voxel.
+	// @return - VOID
+	void CopyTo(TArray<int>& voxels) const;
+
+	// The memory used by the storage in bytes.
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// Receive a section for writing. Sections shared with a copy are copied first.
+	FORCEINLINE FVoxelPaletteStorage& GetMutableSection(int section) {
+		if (!sections[section].IsUnique())
+			sections[section] = MakeShared<FVoxelPaletteStorage, ESPMode::ThreadSafe>(*sections[section]);
+		return *sections[section];
+	}
+
+	// The voxels of every section. Shared between copies of the storage until written.
+	TArray<TSharedPtr<FVoxelPaletteStorage, ESPMode::ThreadSafe>> sections;
+
+	// The order of the voxels inside a section.
+	FVoxelLayout layout;
+
+	// The number of stored voxels.
+	int numOfVoxels = 0;
+
+	// The width of the chunk in voxels.
+	int width = 16;
+
+	// The height of a single section in voxels.
+	int sectionHeight = 16;
+
+	// The number of voxels inside a single section.
+	int sectionSize = 4096;
+};
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VoxelWorldStore.h"
+#include "../VoxelWorld.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stored Chunks"), STAT_VoxelStoredChunks, STATGROUP_VoxelWorld);
+
+FVoxelChunkDataPtr FVoxelWorldStore::FindOrAdd(const FIntPoint& coordinates) {
+
+	if (const FVoxelChunkDataPtr* data = chunks.Find(coordinates))
+		return *data;
+
+	// The voxels are sized by the chunk actor or generator that fills them.
+	FVoxelChunkDataPtr data = MakeShared<FVoxelChunkData>();
+	data->coordinates = coordinates;
+	chunks.Add(coordinates, data);
+	SET_DWORD_STAT(STAT_VoxelStoredChunks, chunks.Num());
+	return data;
+}
+
+bool FVoxelWorldStore::Remove(const FIntPoint& coordinates) {
+
+	bool bRemoved = chunks.Remove(coordinates);
+	SET_DWORD_STAT(STAT_VoxelStoredChunks, chunks.Num());
+	return bRemoved;
+}
+
+void FVoxelWorldStore::Empty() {
+
+	chunks.Empty();
+	SET_DWORD_STAT(STAT_VoxelStoredChunks, 0);
+}
+
+SIZE_T FVoxelWorldStore::GetAllocatedSize() const {
+
+	SIZE_T size = chunks.GetAllocatedSize();
+	chunks.ForEach([&](const FIntPoint& coordinates, const FVoxelChunkDataPtr& data) {
+		size += sizeof(FVoxelChunkData) + data->voxelAssetIDs.GetAllocatedSize() + data->voxelAssetChanged.GetAllocatedSize();
+	});
+	return size;
+}
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelSectionStorage.h"
+#include "ChunkGrid.h"
+
+/* The voxels and the save state of a single chunk. Lives inside the world store, whether a chunk actor renders it or not. */
+struct VOXELWORLD_API FVoxelChunkData {
+
+	// The X and Y index of the chunk in the world.
+	FIntPoint coordinates = FIntPoint(0, 0);
+
+	// The stored asset IDs of voxels inside the chunk, packed into palette indices per vertical section.
+	FVoxelSectionStorage voxelAssetIDs;
+
+	// Have the voxels of this chunk been generated or loaded.
+	bool bGenerated = false;
+
+	// Should this chunk be saved with the next save command.
+	bool markedForSaving = false;
+
+	// Do the voxels differ from the generated ones. Unmodified chunks can be unloaded and generated again.
+	bool bModified = false;
+
+	// The indices of the voxels changed since the last save.
+	TSet<int> voxelAssetChanged;
+
+	// The region the chunk is saved in.
+	FVector2D assignedRegion = FVector2D(0, 0);
+
+	// The X and Y index the chunk is saved with inside its region.
+	int regionIndexX = 0;
+	int regionIndexY = 0;
+};
+
+typedef TSharedPtr<FVoxelChunkData> FVoxelChunkDataPtr;
+
+/* Holds the voxel data of every loaded chunk, independent of the spawned chunk actors.
+   Chunk actors only render the data they are given, so far more chunks can stay loaded than are rendered.
+   Only used on the game thread. Background work receives copies of the voxel storages instead. */
+class VOXELWORLD_API FVoxelWorldStore {
+
+public:
+	// Resize the window of chunks, which are found without hashing.
+	// @param radius - The number of chunks from the origin to the border of the window.
+	// @return - VOID
+	void Init(int radius) {
+		chunks.Init(radius);
+	}
+
+	// Centre the window of chunks, which are found without hashing, on the given chunk.
+	// @param origin - The X and Y index of the centre chunk.
+	// @return - VOID
+	void SetOrigin(const FIntPoint& origin) {
+		chunks.SetOrigin(origin);
+	}
+
+	// Find the data of the chunk at the given coordinates.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The chunk data or nullptr, if the chunk isn't loaded.
+	FVoxelChunkDataPtr Find(const FIntPoint& coordinates) const {
+		return chunks.FindRef(coordinates);
+	}
+
+	// Find the data of the chunk at the given coordinates or add empty data, which still has to be generated.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - The chunk data.
+	FVoxelChunkDataPtr FindOrAdd(const FIntPoint& coordinates);
+
+	// Unload the data of a chunk. Chunk actors still rendering it keep their reference.
+	// @param coordinates - The X and Y index of the chunk.
+	// @return - Was the chunk loaded?
+	bool Remove(const FIntPoint& coordinates);
+
+	// Unload every chunk.
+	void Empty();
+
+	// The number of loaded chunks.
+	int Num() const {
+		return chunks.Num();
+	}
+
+	// Call the given function for every loaded chunk. Chunks must not be added or removed meanwhile.
+	// @param function - A function receiving the coordinates and the chunk data.
+	// @return - VOID
+	template<typename Function>
+	void ForEachChunk(Function&& function) const {
+		chunks.ForEach(function);
+	}
+
+	// The memory used by the voxels of every loaded chunk in bytes.
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// The data of every loaded chunk.
+	TChunkGrid<FVoxelChunkDataPtr> chunks;
+};
@@ -0,0 +1,788 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SimplexNoiseContext.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+// The batched noise uses SSE2, which every x86 CPU supported by the engine has
+#if PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#define SIMPLEX_NOISE_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMPLEX_NOISE_SSE 0
+#endif
+
+
+// FSimplexNoiseContext
+#define FASTFLOOR(x) ( ((x)>0) ? ((int)x) : (((int)x)-1) )
+
+
+// The permutation table of Ken Perlin, used without a seed
+static const unsigned char defaultPerm[512] = { 151,160,137,91,90,15,
+131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+151,160,137,91,90,15,
+131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
+};
+
+FSimplexNoiseContext::FSimplexNoiseContext()
+{
+	FMemory::Memcpy(perm, defaultPerm, sizeof(perm));
+}
+
+FSimplexNoiseContext::FSimplexNoiseContext(int32 seed)
+{
+	// Shuffle the numbers 0 to 255 with a stream of the seed, so no global random state is touched
+	FRandomStream random(seed);
+	for (int it = 0; it < 256; ++it)
+	{
+		perm[it] = (unsigned char)it;
+	}
+	for (int it = 255; it > 0; --it)
+	{
+		Swap(perm[it], perm[random.RandRange(0, it)]);
+	}
+	FMemory::Memcpy(perm + 256, perm, 256);
+}
+
+const FSimplexNoiseContext& FSimplexNoiseContext::GetDefault()
+{
+	static const FSimplexNoiseContext defaultContext;
+	return defaultContext;
+}
+
+const FSimplexNoiseContext& FSimplexNoiseContext::GetShared(int32 seed)
+{
+	// Shared contexts are never destroyed, so references stay valid on every thread
+	static TMap<int32, TUniquePtr<FSimplexNoiseContext>> sharedContexts;
+	static FCriticalSection sharedContextsLock;
+
+	FScopeLock lock(&sharedContextsLock);
+	TUniquePtr<FSimplexNoiseContext>& context = sharedContexts.FindOrAdd(seed);
+	if (!context)
+		context = MakeUnique<FSimplexNoiseContext>(seed);
+	return *context;
+}
+
+static unsigned char simplex[64][4] = {
+	{ 0,1,2,3 },{ 0,1,3,2 },{ 0,0,0,0 },{ 0,2,3,1 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 1,2,3,0 },
+	{ 0,2,1,3 },{ 0,0,0,0 },{ 0,3,1,2 },{ 0,3,2,1 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 1,3,2,0 },
+	{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },
+	{ 1,2,0,3 },{ 0,0,0,0 },{ 1,3,0,2 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 2,3,0,1 },{ 2,3,1,0 },
+	{ 1,0,2,3 },{ 1,0,3,2 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 2,0,3,1 },{ 0,0,0,0 },{ 2,1,3,0 },
+	{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },
+	{ 2,0,1,3 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 3,0,1,2 },{ 3,0,2,1 },{ 0,0,0,0 },{ 3,1,2,0 },
+	{ 2,1,0,3 },{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 },{ 3,1,0,2 },{ 0,0,0,0 },{ 3,2,0,1 },{ 3,2,1,0 } };
+
+
+float FSimplexNoiseContext::grad(int hash, float x)
+{
+	int h = hash & 15;
+	float grad = 1.0f + (h & 7);   // Gradient value 1.0, 2.0, ..., 8.0
+	if (h & 8) grad = -grad;         // Set a random sign for the gradient
+	return (grad * x);           // Multiply the gradient with the distance
+}
+
+
+float FSimplexNoiseContext::grad(int hash, float x, float y)
+{
+	int h = hash & 7;      // Convert low 3 bits of hash code
+	float u = h < 4 ? x : y;  // into 8 simple gradient directions,
+	float v = h < 4 ? y : x;  // and compute the dot product with (x,y).
+	return ((h & 1) ? -u : u) + ((h & 2) ? -2.0f*v : 2.0f*v);
+}
+
+
+float FSimplexNoiseContext::grad(int hash, float x, float y, float z)
+{
+	int h = hash & 15;     // Convert low 4 bits of hash code into 12 simple
+	float u = h < 8 ? x : y; // gradient directions, and compute dot product.
+	float v = h < 4 ? y : h == 12 || h == 14 ? x : z; // Fix repeats at h = 12 to 15
+	return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+
+float FSimplexNoiseContext::grad(int hash, float x, float y, float z, float t)
+{
+	int h = hash & 31;      // Convert low 5 bits of hash code into 32 simple
+	float u = h < 24 ? x : y; // gradient directions, and compute dot product.
+	float v = h < 16 ? y : z;
+	float w = h < 8 ? z : t;
+	return ((h & 1) ? -u : u) + ((h & 2) ? -v : v) + ((h & 4) ? -w : w);
+}
+
+
+
+
+// 1D Simplex Noise
+
+float FSimplexNoiseContext::Noise1D(float x) const
+{
+	int i0 = FASTFLOOR(x);
+	int i1 = i0 + 1;
+	float x0 = x - i0;
+	float x1 = x0 - 1.0f;
+
+	float n0, n1;
+
+	float t0 = 1.0f - x0*x0;
+	//  if(t0 < 0.0f) t0 = 0.0f;
+	t0 *= t0;
+	n0 = t0 * t0 * grad(perm[i0 & 0xff], x0);
+
+	float t1 = 1.0f - x1*x1;
+	//  if(t1 < 0.0f) t1 = 0.0f;
+	t1 *= t1;
+	n1 = t1 * t1 * grad(perm[i1 & 0xff], x1);
+	// The maximum value of this noise is 8*(3/4)^4 = 2.53125
+	// A factor of 0.395 would scale to fit exactly within [-1,1], but
+	// we want to match PRMan's 1D noise, so we scale it down some more.
+	return 0.25f * (n0 + n1);
+}
+
+
+
+// 2D Simplex Noise
+
+float FSimplexNoiseContext::Noise2D(float x, float y) const
+{
+
+#define F2 0.366025403f // F2 = 0.5*(sqrt(3.0)-1.0)
+#define G2 0.211324865f // G2 = (3.0-Math.sqrt(3.0))/6.0
+
+	float n0, n1, n2; // Noise contributions from the three corners
+
+					  // Skew the input space to determine which simplex cell we're in
+	float s = (x + y)*F2; // Hairy factor for 2D
+	float xs = x + s;
+	float ys = y + s;
+	int i = FASTFLOOR(xs);
+	int j = FASTFLOOR(ys);
+
+	float t = (float)(i + j)*G2;
+	float X0 = i - t; // Unskew the cell origin back to (x,y) space
+	float Y0 = j - t;
+	float x0 = x - X0; // The x,y distances from the cell origin
+	float y0 = y - Y0;
+
+	// For the 2D case, the simplex shape is an equilateral triangle.
+	// Determine which simplex we are in.
+	int i1, j1; // Offsets for second (middle) corner of simplex in (i,j) coords
+	if (x0 > y0) { i1 = 1; j1 = 0; } // lower triangle, XY order: (0,0)->(1,0)->(1,1)
+	else { i1 = 0; j1 = 1; }      // upper triangle, YX order: (0,0)->(0,1)->(1,1)
+
+								  // A step of (1,0) in (i,j) means a step of (1-c,-c) in (x,y), and
+								  // a step of (0,1) in (i,j) means a step of (-c,1-c) in (x,y), where
+								  // c = (3-sqrt(3))/6
+
+	float x1 = x0 - i1 + G2; // Offsets for middle corner in (x,y) unskewed coords
+	float y1 = y0 - j1 + G2;
+	float x2 = x0 - 1.0f + 2.0f * G2; // Offsets for last corner in (x,y) unskewed coords
+	float y2 = y0 - 1.0f + 2.0f * G2;
+
+	// Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
+	int ii = i & 0xff;
+	int jj = j & 0xff;
+
+	// Calculate the contribution from the three corners
+	float t0 = 0.5f - x0*x0 - y0*y0;
+	if (t0 < 0.0f) n0 = 0.0f;
+	else {
+		t0 *= t0;
+		n0 = t0 * t0 * grad(perm[ii + perm[jj]], x0, y0);
+	}
+
+	float t1 = 0.5f - x1*x1 - y1*y1;
+	if (t1 < 0.0f) n1 = 0.0f;
+	else {
+		t1 *= t1;
+		n1 = t1 * t1 * grad(perm[ii + i1 + perm[jj + j1]], x1, y1);
+	}
+
+	float t2 = 0.5f - x2*x2 - y2*y2;
+	if (t2 < 0.0f) n2 = 0.0f;
+	else {
+		t2 *= t2;
+		n2 = t2 * t2 * grad(perm[ii + 1 + perm[jj + 1]], x2, y2);
+	}
+
+	// Add contributions from each corner to get the final noise value.
+	// The result is scaled to return values in the interval [-1,1].
+	return 40.0f * (n0 + n1 + n2); // TODO: The scale factor is preliminary!
+}
+
+
+
+
+// 3D Simplex Noise
+float FSimplexNoiseContext::Noise3D(float x, float y, float z) const
+{
+
+	// Simple skewing factors for the 3D case
+#define F3 0.333333333f
+#define G3 0.166666667f
+
+	float n0, n1, n2, n3; // Noise contributions from the four corners
+
+						  // Skew the input space to determine which simplex cell we're in
+	float s = (x + y + z)*F3; // Very nice and simple skew factor for 3D
+	float xs = x + s;
+	float ys = y + s;
+	float zs = z + s;
+	int i = FASTFLOOR(xs);
+	int j = FASTFLOOR(ys);
+	int k = FASTFLOOR(zs);
+
+	float t = (float)(i + j + k)*G3;
+	float X0 = i - t; // Unskew the cell origin back to (x,y,z) space
+	float Y0 = j - t;
+	float Z0 = k - t;
+	float x0 = x - X0; // The x,y,z distances from the cell origin
+	float y0 = y - Y0;
+	float z0 = z - Z0;
+
+	// For the 3D case, the simplex shape is a slightly irregular tetrahedron.
+	// Determine which simplex we are in.
+	int i1, j1, k1; // Offsets for second corner of simplex in (i,j,k) coords
+	int i2, j2, k2; // Offsets for third corner of simplex in (i,j,k) coords
+
+					/* This code would benefit from a backport from the GLSL version! */
+	if (x0 >= y0) {
+		if (y0 >= z0)
+		{
+			i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0;
+		} // X Y Z order
+		else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; } // X Z Y order
+		else { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; } // Z X Y order
+	}
+	else { // x0<y0
+		if (y0 < z0) { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; } // Z Y X order
+		else if (x0 < z0) { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; } // Y Z X order
+		else { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; } // Y X Z order
+	}
+
+	// A step of (1,0,0) in (i,j,k) means a step of (1-c,-c,-c) in (x,y,z),
+	// a step of (0,1,0) in (i,j,k) means a step of (-c,1-c,-c) in (x,y,z), and
+	// a step of (0,0,1) in (i,j,k) means a step of (-c,-c,1-c) in (x,y,z), where
+	// c = 1/6.
+
+	float x1 = x0 - i1 + G3; // Offsets for second corner in (x,y,z) coords
+	float y1 = y0 - j1 + G3;
+	float z1 = z0 - k1 + G3;
+	float x2 = x0 - i2 + 2.0f*G3; // Offsets for third corner in (x,y,z) coords
+	float y2 = y0 - j2 + 2.0f*G3;
+	float z2 = z0 - k2 + 2.0f*G3;
+	float x3 = x0 - 1.0f + 3.0f*G3; // Offsets for last corner in (x,y,z) coords
+	float y3 = y0 - 1.0f + 3.0f*G3;
+	float z3 = z0 - 1.0f + 3.0f*G3;
+
+	// Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
+	int ii = i & 0xff;
+	int jj = j & 0xff;
+	int kk = k & 0xff;
+
+	// Calculate the contribution from the four corners
+	float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0;
+	if (t0 < 0.0f) n0 = 0.0f;
+	else {
+		t0 *= t0;
+		n0 = t0 * t0 * grad(perm[ii + perm[jj + perm[kk]]], x0, y0, z0);
+	}
+
+	float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1;
+	if (t1 < 0.0f) n1 = 0.0f;
+	else {
+		t1 *= t1;
+		n1 = t1 * t1 * grad(perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]], x1, y1, z1);
+	}
+
+	float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2;
+	if (t2 < 0.0f) n2 = 0.0f;
+	else {
+		t2 *= t2;
+		n2 = t2 * t2 * grad(perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]], x2, y2, z2);
+	}
+
+	float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3;
+	if (t3 < 0.0f) n3 = 0.0f;
+	else {
+		t3 *= t3;
+		n3 = t3 * t3 * grad(perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]], x3, y3, z3);
+	}
+
+	// Add contributions from each corner to get the final noise value.
+	// The result is scaled to stay just inside [-1,1]
+	return 32.0f * (n0 + n1 + n2 + n3); // TODO: The scale factor is preliminary!
+}
+
+
+
+
+// Batched Simplex Noise
+// The kernels follow the single point functions step by step, so the results only differ by rounding
+
+#if SIMPLEX_NOISE_SSE
+
+// Select a where the mask is set and b everywhere else
+static FORCEINLINE __m128 Select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// FASTFLOOR for four values, including its results for zero and negative integers
+static FORCEINLINE __m128i FastFloor4(__m128 x)
+{
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i positive = _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, _mm_setzero_ps())), one);
+	return _mm_add_epi32(_mm_sub_epi32(_mm_cvttps_epi32(x), one), positive);
+}
+
+// The sign bit of the given hash bit
+static FORCEINLINE __m128 HashSign4(__m128i h, int bit)
+{
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, bit), 31));
+}
+
+static FORCEINLINE __m128 Grad2D4(__m128i hash, __m128 x, __m128 y)
+{
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(7));
+	__m128 lowHash = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	__m128 u = Select4(lowHash, x, y);
+	__m128 v = Select4(lowHash, y, x);
+	return _mm_add_ps(_mm_xor_ps(u, HashSign4(h, 0)), _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(2.0f), v), HashSign4(h, 1)));
+}
+
+static FORCEINLINE __m128 Grad3D4(__m128i hash, __m128 x, __m128 y, __m128 z)
+{
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+	__m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	__m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	__m128 is12or14 = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+	__m128 u = Select4(below8, x, y);
+	__m128 v = Select4(below4, y, Select4(is12or14, x, z));
+	return _mm_add_ps(_mm_xor_ps(u, HashSign4(h, 0)), _mm_xor_ps(v, HashSign4(h, 1)));
+}
+
+// The contribution of a corner, zero outside of its radius
+static FORCEINLINE __m128 Corner4(__m128 t, __m128 grad)
+{
+	__m128 t2 = _mm_mul_ps(t, t);
+	return _mm_andnot_ps(_mm_cmplt_ps(t, _mm_setzero_ps()), _mm_mul_ps(_mm_mul_ps(t2, t2), grad));
+}
+
+// The hashes are looked up per lane, SSE2 has no gather instruction
+static FORCEINLINE void LoadLanes4(__m128i value, int32* lanes)
+{
+	_mm_storeu_si128((__m128i*)lanes, value);
+}
+
+static __m128 Noise2D4(const unsigned char* perm, __m128 x, __m128 y)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 g2 = _mm_set1_ps(G2);
+
+	// Skew the input space to determine which simplex cell we're in
+	__m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+	__m128i i = FastFloor4(_mm_add_ps(x, s));
+	__m128i j = FastFloor4(_mm_add_ps(y, s));
+
+	__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), g2);
+	__m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+	__m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+	// Lower or upper triangle
+	__m128 lower = _mm_cmpgt_ps(x0, y0);
+	__m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(lower, one)), g2);
+	__m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_andnot_ps(lower, one)), g2);
+	__m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(2.0f * G2));
+	__m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(2.0f * G2));
+
+	// Hash the three corners
+	int32 ii[4], jj[4], i1[4];
+	LoadLanes4(_mm_and_si128(i, _mm_set1_epi32(0xff)), ii);
+	LoadLanes4(_mm_and_si128(j, _mm_set1_epi32(0xff)), jj);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(lower), _mm_set1_epi32(1)), i1);
+	int32 gi0[4], gi1[4], gi2[4];
+	for (int lane = 0; lane < 4; lane++)
+	{
+		gi0[lane] = perm[ii[lane] + perm[jj[lane]]];
+		gi1[lane] = perm[ii[lane] + i1[lane] + perm[jj[lane] + 1 - i1[lane]]];
+		gi2[lane] = perm[ii[lane] + 1 + perm[jj[lane] + 1]];
+	}
+
+	// Calculate the contribution from the three corners
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128 n0 = Corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), Grad2D4(_mm_loadu_si128((const __m128i*)gi0), x0, y0));
+	__m128 n1 = Corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), Grad2D4(_mm_loadu_si128((const __m128i*)gi1), x1, y1));
+	__m128 n2 = Corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), Grad2D4(_mm_loadu_si128((const __m128i*)gi2), x2, y2));
+	return _mm_mul_ps(_mm_set1_ps(40.0f), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+}
+
+static __m128 Noise3D4(const unsigned char* perm, __m128 x, __m128 y, __m128 z)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 g3 = _mm_set1_ps(G3);
+
+	// Skew the input space to determine which simplex cell we're in
+	__m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+	__m128i i = FastFloor4(_mm_add_ps(x, s));
+	__m128i j = FastFloor4(_mm_add_ps(y, s));
+	__m128i k = FastFloor4(_mm_add_ps(z, s));
+
+	__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), g3);
+	__m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+	__m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+	__m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+	// The six orders of the single point function expressed as masks
+	__m128 xy = _mm_cmpge_ps(x0, y0);
+	__m128 yz = _mm_cmpge_ps(y0, z0);
+	__m128 xz = _mm_cmpge_ps(x0, z0);
+	const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 i1 = _mm_and_ps(xy, xz);
+	__m128 j1 = _mm_andnot_ps(xy, yz);
+	__m128 k1 = _mm_andnot_ps(xz, _mm_andnot_ps(yz, all));
+	__m128 i2 = _mm_or_ps(xy, xz);
+	__m128 j2 = _mm_or_ps(_mm_andnot_ps(xy, all), yz);
+	__m128 k2 = _mm_andnot_ps(_mm_and_ps(yz, i2), all);
+
+	__m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i1, one)), g3);
+	__m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j1, one)), g3);
+	__m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k1, one)), g3);
+	__m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i2, one)), _mm_set1_ps(2.0f * G3));
+	__m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j2, one)), _mm_set1_ps(2.0f * G3));
+	__m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k2, one)), _mm_set1_ps(2.0f * G3));
+	__m128 x3 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(3.0f * G3));
+	__m128 y3 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(3.0f * G3));
+	__m128 z3 = _mm_add_ps(_mm_sub_ps(z0, one), _mm_set1_ps(3.0f * G3));
+
+	// Hash the four corners
+	const __m128i byte = _mm_set1_epi32(0xff);
+	const __m128i bit = _mm_set1_epi32(1);
+	int32 ii[4], jj[4], kk[4], oi1[4], oj1[4], ok1[4], oi2[4], oj2[4], ok2[4];
+	LoadLanes4(_mm_and_si128(i, byte), ii);
+	LoadLanes4(_mm_and_si128(j, byte), jj);
+	LoadLanes4(_mm_and_si128(k, byte), kk);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(i1), bit), oi1);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(j1), bit), oj1);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(k1), bit), ok1);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(i2), bit), oi2);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(j2), bit), oj2);
+	LoadLanes4(_mm_and_si128(_mm_castps_si128(k2), bit), ok2);
+	int32 gi0[4], gi1[4], gi2[4], gi3[4];
+	for (int lane = 0; lane < 4; lane++)
+	{
+		gi0[lane] = perm[ii[lane] + perm[jj[lane] + perm[kk[lane]]]];
+		gi1[lane] = perm[ii[lane] + oi1[lane] + perm[jj[lane] + oj1[lane] + perm[kk[lane] + ok1[lane]]]];
+		gi2[lane] = perm[ii[lane] + oi2[lane] + perm[jj[lane] + oj2[lane] + perm[kk[lane] + ok2[lane]]]];
+		gi3[lane] = perm[ii[lane] + 1 + perm[jj[lane] + 1 + perm[kk[lane] + 1]]];
+	}
+
+	// Calculate the contribution from the four corners
+	const __m128 radius = _mm_set1_ps(0.6f);
+	__m128 t0 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(radius, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), _mm_mul_ps(z0, z0));
+	__m128 t1 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(radius, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), _mm_mul_ps(z1, z1));
+	__m128 t2 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(radius, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), _mm_mul_ps(z2, z2));
+	__m128 t3 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(radius, _mm_mul_ps(x3, x3)), _mm_mul_ps(y3, y3)), _mm_mul_ps(z3, z3));
+	__m128 n0 = Corner4(t0, Grad3D4(_mm_loadu_si128((const __m128i*)gi0), x0, y0, z0));
+	__m128 n1 = Corner4(t1, Grad3D4(_mm_loadu_si128((const __m128i*)gi1), x1, y1, z1));
+	__m128 n2 = Corner4(t2, Grad3D4(_mm_loadu_si128((const __m128i*)gi2), x2, y2, z2));
+	__m128 n3 = Corner4(t3, Grad3D4(_mm_loadu_si128((const __m128i*)gi3), x3, y3, z3));
+	return _mm_mul_ps(_mm_set1_ps(32.0f), _mm_add_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), n3));
+}
+
+#endif
+
+void FSimplexNoiseContext::Noise2DArray(const float* x, const float* y, float* result, int num) const
+{
+	int index = 0;
+#if SIMPLEX_NOISE_SSE
+	for (; index + 4 <= num; index += 4)
+	{
+		_mm_storeu_ps(result + index, Noise2D4(perm, _mm_loadu_ps(x + index), _mm_loadu_ps(y + index)));
+	}
+#endif
+	for (; index < num; index++)
+	{
+		result[index] = Noise2D(x[index], y[index]);
+	}
+}
+
+void FSimplexNoiseContext::Noise3DArray(const float* x, const float* y, const float* z, float* result, int num) const
+{
+	int index = 0;
+#if SIMPLEX_NOISE_SSE
+	for (; index + 4 <= num; index += 4)
+	{
+		_mm_storeu_ps(result + index, Noise3D4(perm, _mm_loadu_ps(x + index), _mm_loadu_ps(y + index), _mm_loadu_ps(z + index)));
+	}
+#endif
+	for (; index < num; index++)
+	{
+		result[index] = Noise3D(x[index], y[index], z[index]);
+	}
+}
+
+void FSimplexNoiseContext::Noise2DGrid(const FVector2D& origin, float step, int sizeX, int sizeY, float* result) const
+{
+	for (int y = 0; y < sizeY; y++)
+	{
+		float pointY = origin.Y + y * step;
+		float* row = result + y * sizeX;
+		int x = 0;
+#if SIMPLEX_NOISE_SSE
+		const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+		for (; x + 4 <= sizeX; x += 4)
+		{
+			__m128 pointsX = _mm_add_ps(_mm_set1_ps(origin.X), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), lanes), _mm_set1_ps(step)));
+			_mm_storeu_ps(row + x, Noise2D4(perm, pointsX, _mm_set1_ps(pointY)));
+		}
+#endif
+		for (; x < sizeX; x++)
+		{
+			row[x] = Noise2D(origin.X + x * step, pointY);
+		}
+	}
+}
+
+void FSimplexNoiseContext::Noise3DGrid(const FVector& origin, float step, const FIntVector& size, float* result) const
+{
+	for (int z = 0; z < size.Z; z++)
+	{
+		float pointZ = origin.Z + z * step;
+		for (int y = 0; y < size.Y; y++)
+		{
+			float pointY = origin.Y + y * step;
+			float* row = result + (y + z * size.Y) * size.X;
+			int x = 0;
+#if SIMPLEX_NOISE_SSE
+			const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			for (; x + 4 <= size.X; x += 4)
+			{
+				__m128 pointsX = _mm_add_ps(_mm_set1_ps(origin.X), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), lanes), _mm_set1_ps(step)));
+				_mm_storeu_ps(row + x, Noise3D4(perm, pointsX, _mm_set1_ps(pointY), _mm_set1_ps(pointZ)));
+			}
+#endif
+			for (; x < size.X; x++)
+			{
+				row[x] = Noise3D(origin.X + x * step, pointY, pointZ);
+			}
+		}
+	}
+}
+
+
+
+
+
+// 4D Simplex Noise
+float FSimplexNoiseContext::Noise4D(float x, float y, float z, float w) const
+{
+#define F4 0.309016994f // F4 = (Math.sqrt(5.0)-1.0)/4.0
+#define G4 0.138196601f // G4 = (5.0-Math.sqrt(5.0))/20.0
+
+	float n0, n1, n2, n3, n4; // Noise contributions from the five corners
+
+							  // Skew the (x,y,z,w) space to determine which cell of 24 simplices we're in
+	float s = (x + y + z + w) * F4; // Factor for 4D skewing
+	float xs = x + s;
+	float ys = y + s;
+	float zs = z + s;
+	float ws = w + s;
+	int i = FASTFLOOR(xs);
+	int j = FASTFLOOR(ys);
+	int k = FASTFLOOR(zs);
+	int l = FASTFLOOR(ws);
+
+	float t = (i + j + k + l) * G4; // Factor for 4D unskewing
+	float X0 = i - t; // Unskew the cell origin back to (x,y,z,w) space
+	float Y0 = j - t;
+	float Z0 = k - t;
+	float W0 = l - t;
+
+	float x0 = x - X0;  // The x,y,z,w distances from the cell origin
+	float y0 = y - Y0;
+	float z0 = z - Z0;
+	float w0 = w - W0;
+
+	// For the 4D case, the simplex is a 4D shape I won't even try to describe.
+	// To find out which of the 24 possible simplices we're in, we need to
+	// determine the magnitude ordering of x0, y0, z0 and w0.
+	// The method below is a good way of finding the ordering of x,y,z,w and
+	// then find the correct traversal order for the simplex were in.
+	// First, six pair-wise comparisons are performed between each possible pair
+	// of the four coordinates, and the results are used to add up binary bits
+	// for an integer index.
+	int c1 = (x0 > y0) ? 32 : 0;
+	int c2 = (x0 > z0) ? 16 : 0;
+	int c3 = (y0 > z0) ? 8 : 0;
+	int c4 = (x0 > w0) ? 4 : 0;
+	int c5 = (y0 > w0) ? 2 : 0;
+	int c6 = (z0 > w0) ? 1 : 0;
+	int c = c1 + c2 + c3 + c4 + c5 + c6;
+
+	int i1, j1, k1, l1; // The integer offsets for the second simplex corner
+	int i2, j2, k2, l2; // The integer offsets for the third simplex corner
+	int i3, j3, k3, l3; // The integer offsets for the fourth simplex corner
+
+						// simplex[c] is a 4-vector with the numbers 0, 1, 2 and 3 in some order.
+						// Many values of c will never occur, since e.g. x>y>z>w makes x<z, y<w and x<w
+						// impossible. Only the 24 indices which have non-zero entries make any sense.
+						// We use a thresholding to set the coordinates in turn from the largest magnitude.
+						// The number 3 in the "simplex" array is at the position of the largest coordinate.
+	i1 = simplex[c][0] >= 3 ? 1 : 0;
+	j1 = simplex[c][1] >= 3 ? 1 : 0;
+	k1 = simplex[c][2] >= 3 ? 1 : 0;
+	l1 = simplex[c][3] >= 3 ? 1 : 0;
+	// The number 2 in the "simplex" array is at the second largest coordinate.
+	i2 = simplex[c][0] >= 2 ? 1 : 0;
+	j2 = simplex[c][1] >= 2 ? 1 : 0;
+	k2 = simplex[c][2] >= 2 ? 1 : 0;
+	l2 = simplex[c][3] >= 2 ? 1 : 0;
+	// The number 1 in the "simplex" array is at the second smallest coordinate.
+	i3 = simplex[c][0] >= 1 ? 1 : 0;
+	j3 = simplex[c][1] >= 1 ? 1 : 0;
+	k3 = simplex[c][2] >= 1 ? 1 : 0;
+	l3 = simplex[c][3] >= 1 ? 1 : 0;
+	// The fifth corner has all coordinate offsets = 1, so no need to look that up.
+
+	float x1 = x0 - i1 + G4; // Offsets for second corner in (x,y,z,w) coords
+	float y1 = y0 - j1 + G4;
+	float z1 = z0 - k1 + G4;
+	float w1 = w0 - l1 + G4;
+	float x2 = x0 - i2 + 2.0f*G4; // Offsets for third corner in (x,y,z,w) coords
+	float y2 = y0 - j2 + 2.0f*G4;
+	float z2 = z0 - k2 + 2.0f*G4;
+	float w2 = w0 - l2 + 2.0f*G4;
+	float x3 = x0 - i3 + 3.0f*G4; // Offsets for fourth corner in (x,y,z,w) coords
+	float y3 = y0 - j3 + 3.0f*G4;
+	float z3 = z0 - k3 + 3.0f*G4;
+	float w3 = w0 - l3 + 3.0f*G4;
+	float x4 = x0 - 1.0f + 4.0f*G4; // Offsets for last corner in (x,y,z,w) coords
+	float y4 = y0 - 1.0f + 4.0f*G4;
+	float z4 = z0 - 1.0f + 4.0f*G4;
+	float w4 = w0 - 1.0f + 4.0f*G4;
+
+	// Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
+	int ii = i & 0xff;
+	int jj = j & 0xff;
+	int kk = k & 0xff;
+	int ll = l & 0xff;
+
+	// Calculate the contribution from the five corners
+	float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0 - w0*w0;
+	if (t0 < 0.0f) n0 = 0.0f;
+	else {
+		t0 *= t0;
+		n0 = t0 * t0 * grad(perm[ii + perm[jj + perm[kk + perm[ll]]]], x0, y0, z0, w0);
+	}
+
+	float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1 - w1*w1;
+	if (t1 < 0.0f) n1 = 0.0f;
+	else {
+		t1 *= t1;
+		n1 = t1 * t1 * grad(perm[ii + i1 + perm[jj + j1 + perm[kk + k1 + perm[ll + l1]]]], x1, y1, z1, w1);
+	}
+
+	float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2 - w2*w2;
+	if (t2 < 0.0f) n2 = 0.0f;
+	else {
+		t2 *= t2;
+		n2 = t2 * t2 * grad(perm[ii + i2 + perm[jj + j2 + perm[kk + k2 + perm[ll + l2]]]], x2, y2, z2, w2);
+	}
+
+	float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3 - w3*w3;
+	if (t3 < 0.0f) n3 = 0.0f;
+	else {
+		t3 *= t3;
+		n3 = t3 * t3 * grad(perm[ii + i3 + perm[jj + j3 + perm[kk + k3 + perm[ll + l3]]]], x3, y3, z3, w3);
+	}
+
+	float t4 = 0.6f - x4*x4 - y4*y4 - z4*z4 - w4*w4;
+	if (t4 < 0.0f) n4 = 0.0f;
+	else {
+		t4 *= t4;
+		n4 = t4 * t4 * grad(perm[ii + 1 + perm[jj + 1 + perm[kk + 1 + perm[ll + 1]]]], x4, y4, z4, w4);
+	}
+
+	// Sum up and scale the result to cover the range [-1,1]
+	return 27.0f * (n0 + n1 + n2 + n3 + n4);
+}
+
+
+
+
+// Measure the points per second of the single point and the batched noise, e.g. "voxel.BenchmarkNoise 1000000"
+static void BenchmarkSimplexNoise(const TArray<FString>& args)
+{
+	const FSimplexNoiseContext& context = FSimplexNoiseContext::GetDefault();
+	int numOfPoints = args.Num() > 0 ? FMath::Max(FCString::Atoi(*args[0]), 64) : 1 << 20;
+	int side2D = FMath::CeilToInt(FMath::Sqrt((float)numOfPoints));
+	int side3D = FMath::CeilToInt(FMath::Pow((float)numOfPoints, 1.0f / 3.0f));
+	const FVector origin(-123.4f, 56.7f, -8.9f);
+	const float step = 0.0137f;
+
+	TArray<float> scalar, batched;
+	scalar.SetNumUninitialized(FMath::Max(side2D * side2D, side3D * side3D * side3D));
+	batched.SetNumUninitialized(scalar.Num());
+
+	// 2D on a grid like the columns of a chunk
+	double start = FPlatformTime::Seconds();
+	for (int y = 0; y < side2D; y++)
+		for (int x = 0; x < side2D; x++)
+			scalar[x + y * side2D] = context.Noise2D(origin.X + x * step, origin.Y + y * step);
+	double scalarTime = FPlatformTime::Seconds() - start;
+	start = FPlatformTime::Seconds();
+	context.Noise2DGrid(FVector2D(origin.X, origin.Y), step, side2D, side2D, batched.GetData());
+	double batchedTime = FPlatformTime::Seconds() - start;
+
+	float maxDifference = 0.0f;
+	for (int i = 0; i < side2D * side2D; i++)
+		maxDifference = FMath::Max(maxDifference, FMath::Abs(scalar[i] - batched[i]));
+	UE_LOG(LogTemp, Display, TEXT("SimplexNoise2D: %d points, scalar %.1f Mpoints/s, batched %.1f Mpoints/s, max difference %g"),
+		side2D * side2D, side2D * side2D / scalarTime / 1e6, side2D * side2D / batchedTime / 1e6, maxDifference);
+
+	// 3D on a lattice like the voxels of a chunk
+	start = FPlatformTime::Seconds();
+	for (int z = 0; z < side3D; z++)
+		for (int y = 0; y < side3D; y++)
+			for (int x = 0; x < side3D; x++)
+				scalar[x + (y + z * side3D) * side3D] = context.Noise3D(origin.X + x * step, origin.Y + y * step, origin.Z + z * step);
+	scalarTime = FPlatformTime::Seconds() - start;
+	start = FPlatformTime::Seconds();
+	context.Noise3DGrid(origin, step, FIntVector(side3D), batched.GetData());
+	batchedTime = FPlatformTime::Seconds() - start;
+
+	int numOfPoints3D = side3D * side3D * side3D;
+	maxDifference = 0.0f;
+	for (int i = 0; i < numOfPoints3D; i++)
+		maxDifference = FMath::Max(maxDifference, FMath::Abs(scalar[i] - batched[i]));
+	UE_LOG(LogTemp, Display, TEXT("SimplexNoise3D: %d points, scalar %.1f Mpoints/s, batched %.1f Mpoints/s, max difference %g"),
+		numOfPoints3D, numOfPoints3D / scalarTime / 1e6, numOfPoints3D / batchedTime / 1e6, maxDifference);
+}
+
+static FAutoConsoleCommand BenchmarkSimplexNoiseCommand(
+	TEXT("voxel.BenchmarkNoise"),
+	TEXT("Measures the points per second of the single point and the batched simplex noise and logs their largest difference. Takes the number of points."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSimplexNoise));
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+// The noise functions are moved from the SimplexNoiseLibrary of DevDad - Afan Olovcic @ www.art-and-code.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* The simplex noise of a single seed. The permutation table is created once and never changed afterwards,
+   so a context can be shared by any number of threads. Worlds with different seeds use different contexts. */
+class VOXELWORLD_API FSimplexNoiseContext
+{
+
+public:
+	// Create the context with the original permutation table of Ken Perlin.
+	FSimplexNoiseContext();
+
+	// Create the context with a permutation table shuffled by the seed.
+	// @param seed - The seed of the permutation table.
+	explicit FSimplexNoiseContext(int32 seed);
+
+	// The context with the original permutation table.
+	// @return - The default context.
+	static const FSimplexNoiseContext& GetDefault();
+
+	// A context of the given seed, which is created on the first request and kept until shutdown.
+	// Callers with the same seed share the same context.
+	// @param seed - The seed of the permutation table.
+	// @return - The shared context.
+	static const FSimplexNoiseContext& GetShared(int32 seed);
+
+	// Single points
+
+	float Noise1D(float x) const;
+	float Noise2D(float x, float y) const;
+	float Noise3D(float x, float y, float z) const;
+	float Noise4D(float x, float y, float z, float w) const;
+
+	// Batched points
+	// Four points are evaluated together with SIMD instructions, the results match the single point functions
+
+	// Evaluate the 2D noise for many points at once.
+	// @param x - The X coordinates of the points.
+	// @param y - The Y coordinates of the points.
+	// @param result - The noise of every point.
+	// @param num - The number of points.
+	// @return - VOID
+	void Noise2DArray(const float* x, const float* y, float* result, int num) const;
+
+	// Evaluate the 3D noise for many points at once.
+	// @param x - The X coordinates of the points.
+	// @param y - The Y coordinates of the points.
+	// @param z - The Z coordinates of the points.
+	// @param result - The noise of every point.
+	// @param num - The number of points.
+	// @return - VOID
+	void Noise3DArray(const float* x, const float* y, const float* z, float* result, int num) const;
+
+	// Evaluate the 2D noise on a regular grid, like the columns of a chunk.
+	// @param origin - The position of the first point.
+	// @param step - The distance between two neighbouring points.
+	// @param sizeX - The number of points along X.
+	// @param sizeY - The number of points along Y.
+	// @param result - The noise of every point, indexed by X plus Y times sizeX.
+	// @return - VOID
+	void Noise2DGrid(const FVector2D& origin, float step, int sizeX, int sizeY, float* result) const;
+
+	// Evaluate the 3D noise on a regular lattice, like the voxels of a chunk.
+	// @param origin - The position of the first point.
+	// @param step - The distance between two neighbouring points.
+	// @param size - The number of points along every axis.
+	// @param result - The noise of every point, indexed by X plus Y times size.X plus Z times size.X times size.Y.
+	// @return - VOID
+	void Noise3DGrid(const FVector& origin, float step, const FIntVector& size, float* result) const;
+
+private:
+	static float  grad(int hash, float x);
+	static float  grad(int hash, float x, float y);
+	static float  grad(int hash, float x, float y, float z);
+	static float  grad(int hash, float x, float y, float z, float t);
+
+	// The permutation of the numbers 0 to 255, repeated once to avoid wrapping the indices.
+	unsigned char perm[512];
+};
@@ -23,6 +23,7 @@ I only request that you mention me in the credits for your game in the way that
 
 #include "../VoxelWorld.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
+#include "SimplexNoiseContext.h"
 #include "SimplexNoiseLibrary.generated.h"
 
 /**
@@ -33,16 +34,12 @@ class VOXELWORLD_API USimplexNoiseLibrary : public UBlueprintFunctionLibrary
 {
 	GENERATED_BODY()
 	
-private:
-
-	static unsigned char perm[];
-	static float  grad(int hash, float x);
-	static float  grad(int hash, float x, float y);
-	static float  grad(int hash, float x, float y, float z);
-	static float  grad(int hash, float x, float y, float z, float t);
-
 public:
 
+	// The functions of this library use the default context, which is replaced by setNoiseSeed
+	// Native code running on several threads or for several worlds should keep its own FSimplexNoiseContext
+	static const FSimplexNoiseContext& GetDefaultContext();
+
 	UFUNCTION(BlueprintCallable, Category = "SimplexNoise")
 		static void setNoiseSeed(const int32& newSeed);
 
@@ -58,6 +55,42 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SimplexNoise")
 		static float SimplexNoise4D(float x, float y, float z, float w);
 
+	// Batched noise for native code, see FSimplexNoiseContext
+
+	// Evaluate the 2D noise for many points at once.
+	// @param x - The X coordinates of the points.
+	// @param y - The Y coordinates of the points.
+	// @param result - The noise of every point.
+	// @param num - The number of points.
+	// @return - VOID
+	static void SimplexNoise2DArray(const float* x, const float* y, float* result, int num);
+
+	// Evaluate the 3D noise for many points at once.
+	// @param x - The X coordinates of the points.
+	// @param y - The Y coordinates of the points.
+	// @param z - The Z coordinates of the points.
+	// @param result - The noise of every point.
+	// @param num - The number of points.
+	// @return - VOID
+	static void SimplexNoise3DArray(const float* x, const float* y, const float* z, float* result, int num);
+
+	// Evaluate the 2D noise on a regular grid, like the columns of a chunk.
+	// @param origin - The position of the first point.
+	// @param step - The distance between two neighbouring points.
+	// @param sizeX - The number of points along X.
+	// @param sizeY - The number of points along Y.
+	// @param result - The noise of every point, indexed by X plus Y times sizeX.
+	// @return - VOID
+	static void SimplexNoise2DGrid(const FVector2D& origin, float step, int sizeX, int sizeY, float* result);
+
+	// Evaluate the 3D noise on a regular lattice, like the voxels of a chunk.
+	// @param origin - The position of the first point.
+	// @param step - The distance between two neighbouring points.
+	// @param size - The number of points along every axis.
+	// @param result - The noise of every point, indexed by X plus Y times size.X plus Z times size.X times size.Y.
+	// @return - VOID
+	static void SimplexNoise3DGrid(const FVector& origin, float step, const FIntVector& size, float* result);
+
 	// Scaled by float value
 	UFUNCTION(BlueprintCallable, Category = "SimplexNoise")
 		static float SimplexNoiseScaled1D(float x, float s);
@@ -13,7 +13,7 @@
 FSaveManager* FSaveManager::runnable = NULL;
 
 
-FSaveManager::FSaveManager(FWorldInformation world, TSet<AChunkActor*> chunkList, AChunkManager * manager)
+FSaveManager::FSaveManager(FWorldInformation world, TArray<FChunkSaveSnapshot> chunkList, AChunkManager * manager)
 	: world(world)
 	, bCompleted(false)
 	, chunkList(chunkList)
@@ -74,12 +74,18 @@ bool FSaveManager::IsThreadFinished()
 	return true;
 }
 
-FSaveManager * FSaveManager::JoyInit(FWorldInformation _world, TSet<AChunkActor*> _chunks, AChunkManager * _manager)
+bool FSaveManager::HasThread()
 {
-	if (!runnable && FPlatformProcess::SupportsMultithreading()) {
-		runnable = new FSaveManager(_world, _chunks, _manager);
-	}
+	return runnable != NULL;
+}
+
+FSaveManager * FSaveManager::JoyInit(FWorldInformation _world, TArray<FChunkSaveSnapshot> _chunks, AChunkManager * _manager)
+{
+	// Never hand out the previous save, it doesn't contain the new snapshots.
+	if (runnable || !FPlatformProcess::SupportsMultithreading())
+		return NULL;
 
+	runnable = new FSaveManager(_world, _chunks, _manager);
 	return runnable;
 }
 
@@ -93,13 +99,10 @@ bool FSaveManager::SaveWorld() {
 
 	// Gather the region information.
 	TMap<FVector2D, FRegionInformation> regionMap;
-	for (AChunkActor * chunk : chunkList) {
-
-		// Skip unnecessary chunks.
-		if (!chunk->markedForSaving) continue;
+	for (const FChunkSaveSnapshot& chunk : chunkList) {
 
 		// Create the region save path.
-		FVector2D regionPosition = chunk->assignedRegion;
+		FVector2D regionPosition = chunk.assignedRegion;
 
 		// Add a new region, if none exsists already.
 		if (!regionMap.Contains(regionPosition)) {
@@ -238,28 +241,29 @@ bool FSaveManager::WriteWorldToSave(const FString& filePath) {
 	}
 }
 
-TArray<FChunkInformation> FSaveManager::GatherChunkInformation(AChunkActor * chunkActor) {
-
-	// Check if the fiven chunk is valid.
-	if (!chunkActor) return TArray<FChunkInformation>();
+TArray<FChunkInformation> FSaveManager::GatherChunkInformation(const FChunkSaveSnapshot& chunkSnapshot) {
 
 	// Initialize an empty chunk.
 	TArray<FChunkInformation> chunk;
 
+	// Decode the packed voxels once.
+	TArray<int> voxelAssetIDs;
+	chunkSnapshot.voxelAssetIDs.CopyTo(voxelAssetIDs);
+
 	// Split the chunk into multiple sub chunks.
-	int numOfVerticalSplits = chunkActor->chunkHeight / chunkActor->chunkWidth;
-	int numOfVoxel = chunkActor->voxelAssetIDs.Num() / numOfVerticalSplits;
+	int numOfVerticalSplits = chunkSnapshot.chunkHeight / chunkSnapshot.chunkWidth;
+	int numOfVoxel = voxelAssetIDs.Num() / numOfVerticalSplits;
 	for (int s = 0; s < numOfVerticalSplits; s++) {
 
 		// Initialize the information for this sub chunk.
 		TArray<int> numOfVoxelValues;
 		FChunkInformation subChunk;
-		int lowerCap = (chunkActor->voxelAssetIDs.Num() * s) / numOfVerticalSplits;
-		int upperCap = (chunkActor->voxelAssetIDs.Num() * (s + 1)) / numOfVerticalSplits;
+		int lowerCap = (voxelAssetIDs.Num() * s) / numOfVerticalSplits;
+		int upperCap = (voxelAssetIDs.Num() * (s + 1)) / numOfVerticalSplits;
 
 		// Add the asset values of the chunk to the sub chunk.
 		for (int i = lowerCap; i < upperCap; i++) {
-			int voxelValue = chunkActor->voxelAssetIDs[i];
+			int voxelValue = voxelAssetIDs[i];
 			subChunk.containedVoxel.Add(i - lowerCap, voxelValue);
 
 			if (numOfVoxelValues.IsValidIndex(voxelValue))
@@ -286,7 +290,7 @@ TArray<FChunkInformation> FSaveManager::GatherChunkInformation(AChunkActor * chu
 
 		// Add the remaining information about this sub chunk.
 		subChunk.numOfVoxel = subChunk.containedVoxel.Num();
-		subChunk.position = FVector(chunkActor->chunkIndexX, chunkActor->chunkIndexY, s);
+		subChunk.position = FVector(chunkSnapshot.chunkIndexX, chunkSnapshot.chunkIndexY, s);
 		subChunk.bValidInformation = true;
 
 		// Add this sub chunk to the pool of other sub chunks.
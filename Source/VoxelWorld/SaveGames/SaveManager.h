@@ -3,11 +3,33 @@
 #include "Runtime/Core/Public/Async/AsyncWork.h"
 #include "Runtime/Core/Public/HAL/Runnable.h"
 #include "ReadWriteManager.h"
+#include "../ChunkManagement/VoxelSectionStorage.h"
 #include "CoreMinimal.h"
 
 // Forward-Declarations
 class AChunkManager;
-class AChunkActor;
+
+// A stable copy of everything needed to save a chunk. Captured on the game thread and read by the save thread.
+struct FChunkSaveSnapshot {
+
+	// The region the chunk belongs to.
+	FVector2D assignedRegion = FVector2D(0, 0);
+
+	// The X index of the chunk inside its region.
+	int chunkIndexX = 0;
+
+	// The Y index of the chunk inside its region.
+	int chunkIndexY = 0;
+
+	// The width of the chunk in voxels.
+	int chunkWidth = 16;
+
+	// The height of the chunk in voxels.
+	int chunkHeight = 128;
+
+	// The voxels of the chunk. Shares its sections with the chunk until the chunk edits them.
+	FVoxelSectionStorage voxelAssetIDs;
+};
 
 // This save manager will save the given information into files.
 class FSaveManager : public FRunnable {
@@ -26,8 +48,8 @@ public:
 	// The world information.
 	FWorldInformation world;
 
-	// The chunks to save.
-	TSet<AChunkActor*> chunkList;
+	// The snapshots of the chunks to save.
+	TArray<FChunkSaveSnapshot> chunkList;
 
 	// The chunk manager to call the return function.
 	AChunkManager* manager;
@@ -36,7 +58,7 @@ public:
 public:
 
 	// The default constructor. Also sets the internal variables.
-	FSaveManager(FWorldInformation world, TSet<AChunkActor*> chunkList, AChunkManager* manager);
+	FSaveManager(FWorldInformation world, TArray<FChunkSaveSnapshot> chunkList, AChunkManager* manager);
 	virtual ~FSaveManager();
 
 	bool IsFinished() const {
@@ -53,7 +75,10 @@ public:
 
 	static bool IsThreadFinished();
 
-	static FSaveManager* JoyInit(FWorldInformation _world, TSet<AChunkActor*> _chunks, AChunkManager* _manager);
+	// Check, if a save thread exists, which hasn't been shut down yet. Finished or not.
+	static bool HasThread();
+
+	static FSaveManager* JoyInit(FWorldInformation _world, TArray<FChunkSaveSnapshot> _chunks, AChunkManager* _manager);
 	
 	// Save the given chunks to a save file.
 	bool SaveWorld();
@@ -64,8 +89,8 @@ public:
 	// Write the given world information to a save file.
 	bool WriteWorldToSave(const FString& filePath);
 
-	// Breack a chunk actor into its information.
-	TArray<FChunkInformation> GatherChunkInformation(AChunkActor* chunkActor);
+	// Breack a chunk snapshot into its information.
+	TArray<FChunkInformation> GatherChunkInformation(const FChunkSaveSnapshot& chunkSnapshot);
 
 
 };